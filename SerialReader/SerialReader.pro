@@ -9,13 +9,50 @@ CONFIG += c++11
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    acquisitionsession.cpp \
+    capturefile.cpp \
+    captureplayback.cpp \
+    capturewriter.cpp \
+    channelbuffer.cpp \
+    csvexporter.cpp \
+    framedecoder.cpp \
+    headlesscapture.cpp \
+    latencystats.cpp \
     main.cpp \
     mainwindow.cpp \
-    qcustomplot.cpp
+    numberformat.cpp \
+    qcustomplot.cpp \
+    rangetracker.cpp \
+    renderscheduler.cpp \
+    sampleparser.cpp \
+    serialreader.cpp \
+    signalprocessor.cpp \
+    simulatedport.cpp \
+    streamaligner.cpp
 
 HEADERS += \
+    acquisitionsession.h \
+    capturefile.h \
+    captureformat.h \
+    captureplayback.h \
+    capturewriter.h \
+    channelbuffer.h \
+    csvexporter.h \
+    framedecoder.h \
+    headlesscapture.h \
+    latencystats.h \
     mainwindow.h \
-    qcustomplot.h
+    numberformat.h \
+    qcustomplot.h \
+    rangetracker.h \
+    renderscheduler.h \
+    ringbuffer.h \
+    sample.h \
+    sampleparser.h \
+    serialreader.h \
+    signalprocessor.h \
+    simulatedport.h \
+    streamaligner.h
 
 FORMS += \
     mainwindow.ui
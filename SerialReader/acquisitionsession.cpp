@@ -0,0 +1,188 @@
+// Definition of methods for the AcquisitionSession class
+
+#include "acquisitionsession.h"
+
+#include <QDir>
+#include <QFileInfo>
+
+
+namespace {
+
+// Capacity of the ring buffer of every port
+const std::size_t ringCapacity = 16384;
+
+}
+
+// Constructor of the AcquisitionSession class
+//
+// The threads of the pool are created by start(), as many as the ports need, and kept
+// (idle) until the session is destroyed
+AcquisitionSession::AcquisitionSession(QObject *parent)
+    : QObject(parent)
+    , startedCount(0)
+    , generation(0)
+    , droppedBefore(0)
+    , overrunBefore(0)
+{
+}
+
+// Destructor of the AcquisitionSession class
+//
+// The readers (and their serial ports) are deleted in their threads once their event loops have finished
+AcquisitionSession::~AcquisitionSession()
+{
+    stop();
+    for (QThread *thread : threads)
+    {
+        thread->quit();
+        thread->wait();
+        delete thread;
+    }
+    qDeleteAll(rings);
+}
+
+QStringList AcquisitionSession::splitPortNames(const QString &text)
+{
+    QStringList names;
+    for (const QString &name : text.split(';'))
+    {
+        if (!name.trimmed().isEmpty())
+        {
+            names.append(name.trimmed());
+        }
+    }
+    return names;
+}
+
+QString AcquisitionSession::recordingFileName(const QString &fileName, int port, int portCount)
+{
+    if (portCount <= 1)
+    {
+        return fileName;
+    }
+    const QFileInfo info(fileName);
+    QString name = info.completeBaseName() + "-" + QString::number(port + 1);
+    if (!info.suffix().isEmpty())
+    {
+        name += "." + info.suffix();
+    }
+    return info.dir().filePath(name);
+}
+
+// Public method that opens the ports
+//
+// A reader is created for every port and moved to one of the threads of the pool, round-robin.
+// The ports are opened by the readers in their threads
+void AcquisitionSession::start(const QStringList &portNames, qint32 baudRate, const DecoderSettings &settings)
+{
+    stop();
+
+    qDeleteAll(rings);
+    rings.clear();
+    names = portNames;
+    startedCount = 0;
+    droppedBefore = 0;
+    overrunBefore = 0;
+
+    const int threadCount = qBound(1, (names.size() + PortsPerThread - 1) / PortsPerThread, qMax(1, QThread::idealThreadCount()));
+    while (threads.size() < threadCount)
+    {
+        threads.append(new QThread());
+        threads.last()->start();
+    }
+
+    const int current = generation;
+    for (int port = 0; port < names.size(); ++port)
+    {
+        rings.append(new RingBuffer<Sample>(ringCapacity));
+        SerialReader *reader = new SerialReader(rings[port]);
+        reader->moveToThread(threads[port % threadCount]);
+        readers.append(reader);
+
+        QObject::connect(reader, &SerialReader::started, this, [this, current]() {
+            if (current == generation && ++startedCount == readers.size())
+            {
+                emit started();
+            }
+        });
+        QObject::connect(reader, &SerialReader::errorOccurred, this, [this, current, port](const QString &message) {
+            if (current == generation)
+            {
+                emit errorOccurred(describe(port, message));
+            }
+        });
+        QObject::connect(reader, &SerialReader::recordingError, this, [this, current, port](const QString &message) {
+            if (current == generation)
+            {
+                emit recordingError(describe(port, message));
+            }
+        });
+
+        QMetaObject::invokeMethod(reader, "start", Qt::QueuedConnection,
+                                  Q_ARG(QString, names[port]), Q_ARG(qint32, baudRate), Q_ARG(DecoderSettings, settings));
+    }
+}
+
+// Public method that closes the ports
+//
+// Every reader stops in its own thread (the call blocks until it has) and is then deleted there
+void AcquisitionSession::stop()
+{
+    if (readers.isEmpty())
+    {
+        return;
+    }
+
+    ++generation;
+    for (SerialReader *reader : readers)
+    {
+        QMetaObject::invokeMethod(reader, "stop", Qt::BlockingQueuedConnection);
+        droppedBefore += reader->droppedSamples();
+        overrunBefore += reader->overrunBytes();
+        reader->deleteLater();
+    }
+    readers.clear();
+}
+
+void AcquisitionSession::startRecording(const QString &fileName)
+{
+    for (int port = 0; port < readers.size(); ++port)
+    {
+        QMetaObject::invokeMethod(readers[port], "startRecording", Qt::QueuedConnection,
+                                  Q_ARG(QString, recordingFileName(fileName, port, readers.size())));
+    }
+}
+
+void AcquisitionSession::stopRecording()
+{
+    for (SerialReader *reader : readers)
+    {
+        QMetaObject::invokeMethod(reader, "stopRecording", Qt::QueuedConnection);
+    }
+}
+
+quint64 AcquisitionSession::droppedSamples() const
+{
+    quint64 dropped = droppedBefore;
+    for (const SerialReader *reader : readers)
+    {
+        dropped += reader->droppedSamples();
+    }
+    return dropped;
+}
+
+quint64 AcquisitionSession::overrunBytes() const
+{
+    quint64 overrun = overrunBefore;
+    for (const SerialReader *reader : readers)
+    {
+        overrun += reader->overrunBytes();
+    }
+    return overrun;
+}
+
+// Private method that prefixes message with the name of port when there are several ports
+QString AcquisitionSession::describe(int port, const QString &message) const
+{
+    return names.size() > 1 ? names[port] + ": " + message : message;
+}
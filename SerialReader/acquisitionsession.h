@@ -0,0 +1,97 @@
+#ifndef ACQUISITIONSESSION_H
+#define ACQUISITIONSESSION_H
+
+#include <QObject>
+#include <QThread>
+#include <QVector>
+#include <QString>
+#include <QStringList>
+
+#include "ringbuffer.h"
+#include "sample.h"
+#include "serialreader.h"
+
+// Definition of the class that acquires data from any number of serial ports at once
+//
+// Every port is read by its own SerialReader, which pushes its samples into its own ring buffer,
+// so every ring keeps a single producer and a single consumer. Rather than one thread per port,
+// the readers are spread over a small pool of threads (PortsPerThread ports per thread, and no
+// more threads than cores): the event loop of each thread waits on all of its ports at once
+// (poll/epoll, or overlapped I/O on Windows) and drains each of them without blocking as soon as
+// bytes arrive. All readers timestamp samples with the same monotonic clock, so the data of
+// all ports share the same time axis.
+class AcquisitionSession : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Number of ports serviced by each thread of the pool
+    static const int PortsPerThread = 4;
+
+    explicit AcquisitionSession(QObject *parent = nullptr);
+    ~AcquisitionSession();
+
+    // Splits a list of port names separated by ';' (e.g. "COM3;COM4"), ignoring empty ones
+    static QStringList splitPortNames(const QString &text);
+
+    // File each port is recorded to: fileName itself with a single port, otherwise fileName
+    // with the (1-based) index of the port appended to its base name (run.srcap -> run-2.srcap)
+    static QString recordingFileName(const QString &fileName, int port, int portCount);
+
+    // Opens every port. started() is emitted once all of them are open, errorOccurred() if any fails
+    void start(const QStringList &portNames, qint32 baudRate, const DecoderSettings &settings);
+
+    // Closes every port (and capture file). Once it returns no sample is pushed anymore, and
+    // the samples still in the rings can be popped until the next call to start()
+    void stop();
+
+    // Records every port to its own capture file (see recordingFileName())
+    void startRecording(const QString &fileName);
+
+    void stopRecording();
+
+    bool isRunning() const { return !readers.isEmpty(); }
+
+    int portCount() const { return names.size(); }
+
+    const QStringList &portNames() const { return names; }
+
+    RingBuffer<Sample> &ring(int port) { return *rings[port]; }
+
+    // Samples lost by all ports since start() because their rings were full
+    quint64 droppedSamples() const;
+
+    // Bytes discarded by all simulated ports since start() because their links couldn't keep up
+    quint64 overrunBytes() const;
+
+signals:
+    void started();
+
+    // A port could not be opened (the message starts with its name when there are several)
+    // or a capture file could not be written
+    void errorOccurred(const QString &message);
+
+    void recordingError(const QString &message);
+
+private:
+    QString describe(int port, const QString &message) const;
+
+    QStringList names;
+
+    QVector<RingBuffer<Sample> *> rings;
+
+    QVector<SerialReader *> readers;
+
+    QVector<QThread *> threads;
+
+    int startedCount;
+
+    // Incremented by stop(), so that signals queued by the readers of a previous start() are ignored
+    int generation;
+
+    quint64 droppedBefore;
+
+    quint64 overrunBefore;
+};
+
+#endif // ACQUISITIONSESSION_H
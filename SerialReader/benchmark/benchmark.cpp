@@ -0,0 +1,357 @@
+// Benchmarks of the ingest-parse-append-render pipeline
+//
+// Every benchmark runs its workload once to warm up, then a fixed number of iterations, and
+// reports the throughput (items per second, the items being bytes decoded, samples appended,
+// points sampled or replots), the time per iteration and the number of heap allocations per
+// iteration. Run with --quick for smaller data sets.
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QScopedPointer>
+#include <QStringList>
+
+#include "framedecoder.h"
+#include "numberformat.h"
+#include "qcustomplot.h"
+
+
+// Heap allocations made by the process. Qt containers allocate with malloc, so on glibc malloc
+// itself is counted; elsewhere only operator new is
+static std::atomic<quint64> allocations(0);
+
+#if defined(__GLIBC__)
+#define COUNT_MALLOC 1
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *pointer, std::size_t size);
+
+void *malloc(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t count, std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+}
+#else
+#define COUNT_MALLOC 0
+#endif
+
+void *operator new(std::size_t size)
+{
+    if (!COUNT_MALLOC)
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    void *pointer = std::malloc(size > 0 ? size : 1);
+    if (pointer == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+
+namespace {
+
+// Runs func (which processes items items) iterations times after a warm-up run, and prints the results
+template <typename Func>
+void run(const QString &name, qint64 items, const char *unit, int iterations, Func func)
+{
+    func();
+
+    const quint64 allocationsBefore = allocations.load(std::memory_order_relaxed);
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < iterations; ++i)
+    {
+        func();
+    }
+    const qint64 ns = qMax(timer.nsecsElapsed(), Q_INT64_C(1));
+    const quint64 allocated = allocations.load(std::memory_order_relaxed) - allocationsBefore;
+
+    const double throughput = double(items) * iterations / (ns * 1e-9);
+    const QString line = QString("%1 %2 %3 %4")
+            .arg(name, -48)
+            .arg(QString("%1 %2/s").arg(throughput, 0, 'g', 4).arg(unit), 22)
+            .arg(QString("%1 ms").arg(ns / 1e6 / iterations, 0, 'f', 3), 14)
+            .arg(double(allocated) / iterations, 14, 'f', 1);
+    std::printf("%s\n", line.toLocal8Bit().constData());
+    std::fflush(stdout);
+}
+
+void printHeader(const char *title)
+{
+    const QString line = QString("%1 %2 %3 %4").arg(QString(title), -48).arg(QString("throughput"), 22)
+            .arg(QString("time/iteration"), 14).arg(QString("allocs/iter"), 14);
+    std::printf("\n%s\n", line.toLocal8Bit().constData());
+}
+
+// Signal used by all benchmarks: a sine plus uniform noise
+double signal(qint64 i, std::mt19937 &random)
+{
+    return std::sin(i * 1e-3) + std::uniform_real_distribution<double>(-0.1, 0.1)(random);
+}
+
+// Feeds data to a new decoder in chunks of the size read by SerialReader::readSerial(),
+// clearing the batch after every chunk as it does
+void decodeAll(const DecoderSettings &settings, const QByteArray &data)
+{
+    QScopedPointer<FrameDecoder> decoder(FrameDecoder::create(settings));
+    FrameBatch batch;
+    const int chunk = 16384;
+    for (int offset = 0; offset < data.size(); offset += chunk)
+    {
+        decoder->decode(data.constData() + offset, qMin(chunk, data.size() - offset), batch);
+        batch.clear();
+    }
+}
+
+void benchmarkDecoders(qint64 frames)
+{
+    printHeader("Decoding (chunks of 16 KiB)");
+    std::mt19937 random(1);
+    char text[40];
+
+    QByteArray stream;
+    for (qint64 i = 0; i < frames; ++i)
+    {
+        stream.append(text, formatDouble(signal(i, random), 6, text));
+        stream.append(',');
+    }
+    DecoderSettings settings;
+    settings.type = DecoderSettings::CsvStream;
+    run(QString("CSV stream, %1 values").arg(frames), stream.size(), "B", 5, [&]() { decodeAll(settings, stream); });
+
+    QByteArray lines;
+    for (qint64 i = 0; i < frames; ++i)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            lines.append(text, formatDouble(signal(i, random) + c, 6, text));
+            lines.append(c < 3 ? ',' : '\n');
+        }
+    }
+    settings.type = DecoderSettings::CsvLines;
+    run(QString("CSV lines, %1 frames of 4 channels").arg(frames), lines.size(), "B", 5, [&]() { decodeAll(settings, lines); });
+
+    QByteArray binary;
+    for (qint64 i = 0; i < frames; ++i)
+    {
+        const qint16 a = qint16(1000 * signal(i, random));
+        const qint16 b = qint16(i);
+        const float c = float(signal(i, random));
+        const float d = float(i);
+        binary.append("\xAA\x55", 2);
+        binary.append(reinterpret_cast<const char *>(&a), sizeof(a));
+        binary.append(reinterpret_cast<const char *>(&b), sizeof(b));
+        binary.append(reinterpret_cast<const char *>(&c), sizeof(c));
+        binary.append(reinterpret_cast<const char *>(&d), sizeof(d));
+    }
+    settings.type = DecoderSettings::BinaryStruct;
+    settings.syncBytes = QByteArray("\xAA\x55", 2);
+    DecoderSettings::parseLayout("i16,i16,f32,f32", settings.fields);
+    run(QString("Binary struct, %1 frames of 4 channels").arg(frames), binary.size(), "B", 5, [&]() { decodeAll(settings, binary); });
+}
+
+void benchmarkContainer(int points)
+{
+    printHeader("QCPDataContainer::add (batches of 1000 points)");
+    std::mt19937 random(2);
+    const int batchSize = 1000;
+
+    QVector<QVector<QCPGraphData> > sorted, shuffled;
+    for (int b = 0; b < points / batchSize; ++b)
+    {
+        QVector<QCPGraphData> batch;
+        for (int i = 0; i < batchSize; ++i)
+        {
+            const qint64 key = qint64(b) * batchSize + i;
+            batch.append(QCPGraphData(key, signal(key, random)));
+        }
+        sorted.append(batch);
+        std::shuffle(batch.begin(), batch.end(), random);
+        shuffled.append(batch);
+    }
+
+    run(QString("Sorted appends, %1 points").arg(points), points, "samples", 5, [&]() {
+        QCPGraphDataContainer data;
+        for (int b = 0; b < sorted.size(); ++b)
+        {
+            data.add(sorted[b], true);
+        }
+    });
+    run(QString("Unsorted appends, %1 points").arg(points), points, "samples", 5, [&]() {
+        QCPGraphDataContainer data;
+        for (int b = 0; b < shuffled.size(); ++b)
+        {
+            data.add(shuffled[b], false);
+        }
+    });
+
+    // batches that interleave with the data already in the container need a merge
+    const int mergePoints = qMin(points, 100000);
+    QVector<QVector<QCPGraphData> > interleaved(mergePoints / batchSize);
+    for (int i = 0; i < mergePoints; ++i)
+    {
+        interleaved[i % interleaved.size()].append(QCPGraphData(i, signal(i, random)));
+    }
+    run(QString("Interleaved (merged) adds, %1 points").arg(mergePoints), mergePoints, "samples", 3, [&]() {
+        QCPGraphDataContainer data;
+        for (int b = 0; b < interleaved.size(); ++b)
+        {
+            data.add(interleaved[b], true);
+        }
+    });
+}
+
+// Graph that gives access to the adaptive sampling of QCPGraph
+class BenchmarkGraph : public QCPGraph
+{
+public:
+    BenchmarkGraph(QCPAxis *keyAxis, QCPAxis *valueAxis) : QCPGraph(keyAxis, valueAxis) {}
+
+    using QCPGraph::getOptimizedLineData;
+};
+
+void benchmarkSampling(const QVector<int> &sizes)
+{
+    printHeader("QCPGraph::getOptimizedLineData (1280 px wide)");
+    std::mt19937 random(3);
+
+    for (int size : sizes)
+    {
+        QCustomPlot plot;
+        plot.resize(1280, 720);
+        BenchmarkGraph *graph = new BenchmarkGraph(plot.xAxis, plot.yAxis);
+        QVector<double> keys(size), values(size);
+        for (int i = 0; i < size; ++i)
+        {
+            keys[i] = i;
+            values[i] = signal(i, random);
+        }
+        graph->setData(keys, values, true);
+        plot.replot();
+
+        for (double zoom : {1.0, 0.1, 0.01})
+        {
+            plot.xAxis->setRange(size * (1 - zoom) / 2, size * (1 + zoom) / 2);
+            QCPGraphDataContainer::const_iterator begin = graph->data()->findBegin(plot.xAxis->range().lower);
+            QCPGraphDataContainer::const_iterator end = graph->data()->findEnd(plot.xAxis->range().upper);
+            QVector<QCPGraphData> lineData;
+            run(QString("%1 points, %2% visible").arg(size).arg(zoom * 100), end - begin, "points", 20, [&]() {
+                lineData.clear();
+                graph->getOptimizedLineData(&lineData, begin, end);
+            });
+        }
+    }
+}
+
+void benchmarkRendering(int points)
+{
+    printHeader("Offscreen rendering (1280x720, 4 graphs)");
+    std::mt19937 random(4);
+
+    QCustomPlot plot;
+    plot.resize(1280, 720);
+    for (int c = 0; c < 4; ++c)
+    {
+        QVector<double> keys(points), values(points);
+        for (int i = 0; i < points; ++i)
+        {
+            keys[i] = i;
+            values[i] = signal(i, random) + c;
+        }
+        plot.addGraph()->setData(keys, values, true);
+    }
+    plot.rescaleAxes();
+
+    run(QString("replot, %1 points per graph").arg(points), 1, "replots", 20, [&]() {
+        plot.replot(QCustomPlot::rpImmediateRefresh);
+    });
+    run(QString("toPixmap, %1 points per graph").arg(points), 1, "pixmaps", 10, [&]() {
+        plot.toPixmap(1280, 720);
+    });
+
+    // the live acquisition path: append a frame worth of samples to every graph, then replot
+    const int frameSamples = 1000;
+    QVector<double> keys(frameSamples), values(frameSamples);
+    double nextKey = points;
+    run(QString("append %1 samples + replot").arg(frameSamples), frameSamples * 4, "samples", 20, [&]() {
+        for (int i = 0; i < frameSamples; ++i)
+        {
+            keys[i] = nextKey + i;
+            values[i] = signal(qint64(keys[i]), random);
+        }
+        nextKey += frameSamples;
+        for (int c = 0; c < plot.graphCount(); ++c)
+        {
+            plot.graph(c)->addData(keys, values, true);
+        }
+        plot.xAxis->setRange(0, nextKey);
+        plot.replot(QCustomPlot::rpImmediateRefresh);
+    });
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    // The plots are rendered offscreen, so the benchmarks also run on headless machines
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    const bool quick = app.arguments().contains("--quick");
+
+    benchmarkDecoders(quick ? 200000 : 2000000);
+    benchmarkContainer(quick ? 100000 : 1000000);
+    benchmarkSampling(quick ? QVector<int>({100000, 1000000}) : QVector<int>({100000, 1000000, 10000000}));
+    benchmarkRendering(quick ? 50000 : 250000);
+    return 0;
+}
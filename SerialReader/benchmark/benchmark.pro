@@ -0,0 +1,25 @@
+# Benchmarks of the acquisition and plotting hot paths (decoding, data container appends,
+# adaptive sampling and offscreen replots). Built separately from the application:
+#   qmake benchmark.pro && make && ./benchmark [--quick]
+
+QT       += core gui printsupport widgets
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = benchmark
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    benchmark.cpp \
+    ../framedecoder.cpp \
+    ../numberformat.cpp \
+    ../qcustomplot.cpp \
+    ../sampleparser.cpp
+
+HEADERS += \
+    ../framedecoder.h \
+    ../numberformat.h \
+    ../qcustomplot.h \
+    ../sampleparser.h
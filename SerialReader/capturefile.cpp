@@ -0,0 +1,411 @@
+// Definition of methods for the CaptureFile class
+
+#include "capturefile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+
+namespace {
+
+// Extends the extremes of a bucket with value, seen at time (NaN values are ignored)
+void includeValue(double value, qint64 time, double &minValue, qint64 &minTime, double &maxValue, qint64 &maxTime)
+{
+    if (qIsNaN(value))
+    {
+        return;
+    }
+    if (!(value >= minValue)) { minValue = value; minTime = time; }
+    if (!(value <= maxValue)) { maxValue = value; maxTime = time; }
+}
+
+}
+
+// Constructor of the CaptureFile class
+CaptureFile::CaptureFile()
+    : map(nullptr)
+    , size(0)
+    , wallClock(0)
+    , totalFrames(0)
+{
+}
+
+// Destructor of the CaptureFile class
+CaptureFile::~CaptureFile()
+{
+    close();
+}
+
+// Public method that maps the file and builds the list of its blocks.
+// Returns false (see errorString()) if the file can't be read or isn't a capture file
+bool CaptureFile::open(const QString &fileName)
+{
+    close();
+
+    file.setFileName(fileName);
+    if (!file.open(QFile::ReadOnly))
+    {
+        error = file.errorString();
+        return false;
+    }
+    size = file.size();
+    map = size > 0 ? file.map(0, size) : nullptr;
+    if (map == nullptr)
+    {
+        error = size > 0 ? file.errorString() : QString("The file is empty");
+        close();
+        return false;
+    }
+
+    CaptureFileHeader header;
+    if (size < qint64(sizeof(header)))
+    {
+        error = "The file is not a capture file";
+        close();
+        return false;
+    }
+    std::memcpy(&header, map, sizeof(header));
+    if (std::memcmp(header.magic, Capture::Magic, sizeof(header.magic)) != 0 || header.version != Capture::Version)
+    {
+        error = "The file is not a capture file";
+        close();
+        return false;
+    }
+    if (header.byteOrderMark != Capture::ByteOrderMark)
+    {
+        error = "The capture file was written on a machine with a different byte order";
+        close();
+        return false;
+    }
+    const qint64 dataStart = qint64(sizeof(header)) + qint64(header.channelCount) * qint64(sizeof(CaptureChannelInfo));
+    if (header.channelCount == 0 || dataStart > size)
+    {
+        error = "The capture file has no channels";
+        close();
+        return false;
+    }
+
+    wallClock = header.startTime;
+    for (quint32 c = 0; c < header.channelCount; ++c)
+    {
+        CaptureChannelInfo info;
+        std::memcpy(&info, map + sizeof(header) + c * sizeof(info), sizeof(info));
+        info.name[sizeof(info.name) - 1] = 0;
+        channelNames.append(QString::fromUtf8(info.name));
+    }
+
+    // A complete file ends with a trailer pointing to the indexes. Otherwise, the chunks are walked
+    const qint64 trailerOffset = size - qint64(sizeof(CaptureChunkHeader) + sizeof(CaptureTrailer));
+    bool ok = false;
+    if (trailerOffset >= dataStart)
+    {
+        CaptureChunkHeader chunk;
+        std::memcpy(&chunk, map + trailerOffset, sizeof(chunk));
+        if (chunk.type == Capture::ChunkTrailer && chunk.size == sizeof(CaptureTrailer))
+        {
+            ok = readIndexes(trailerOffset);
+        }
+    }
+    if (!ok)
+    {
+        blocks.clear();
+        totalFrames = 0;
+        scanChunks(dataStart);
+    }
+    return true;
+}
+
+void CaptureFile::close()
+{
+    if (map != nullptr)
+    {
+        file.unmap(map);
+        map = nullptr;
+    }
+    file.close();
+    size = 0;
+    totalFrames = 0;
+    channelNames.clear();
+    blocks.clear();
+}
+
+qint64 CaptureFile::firstTime() const
+{
+    return blocks.isEmpty() ? 0 : blocks.first().firstTime;
+}
+
+qint64 CaptureFile::lastTime() const
+{
+    return blocks.isEmpty() ? 0 : blocks.last().lastTime;
+}
+
+// Private method that collects the blocks listed by the chain of index chunks, from the last one
+// back to the first. Returns false if the chain is broken, in which case the chunks are walked instead
+bool CaptureFile::readIndexes(qint64 trailerOffset)
+{
+    CaptureTrailer trailer;
+    std::memcpy(&trailer, map + trailerOffset + sizeof(CaptureChunkHeader), sizeof(trailer));
+
+    QVector<QVector<CaptureIndexEntry> > indexes;
+    qint64 offset = trailer.lastIndex;
+    while (offset >= 0)
+    {
+        CaptureChunkHeader chunk;
+        CaptureIndexHeader header;
+        if (offset + qint64(sizeof(chunk) + sizeof(header)) > size)
+        {
+            return false;
+        }
+        std::memcpy(&chunk, map + offset, sizeof(chunk));
+        std::memcpy(&header, map + offset + sizeof(chunk), sizeof(header));
+        const qint64 entriesOffset = offset + qint64(sizeof(chunk) + sizeof(header));
+        if (chunk.type != Capture::ChunkIndex || entriesOffset + qint64(header.entryCount) * qint64(sizeof(CaptureIndexEntry)) > size
+            || header.previousIndex >= offset)
+        {
+            return false;
+        }
+        QVector<CaptureIndexEntry> entries(int(header.entryCount));
+        std::memcpy(entries.data(), map + entriesOffset, header.entryCount * sizeof(CaptureIndexEntry));
+        indexes.prepend(entries);
+        offset = header.previousIndex;
+    }
+
+    for (int i = 0; i < indexes.size(); ++i)
+    {
+        for (int k = 0; k < indexes[i].size(); ++k)
+        {
+            if (!addBlock(indexes[i][k].offset))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Private method that walks the chunks from offset up to the end of the file (or the first
+// truncated chunk), adding every block found. Returns false if the file was truncated
+bool CaptureFile::scanChunks(qint64 offset)
+{
+    while (offset + qint64(sizeof(CaptureChunkHeader)) <= size)
+    {
+        CaptureChunkHeader chunk;
+        std::memcpy(&chunk, map + offset, sizeof(chunk));
+        const qint64 next = offset + qint64(sizeof(chunk)) + chunk.size;
+        if (next > size)
+        {
+            return false;
+        }
+        if (chunk.type == Capture::ChunkBlock && !addBlock(offset))
+        {
+            return false;
+        }
+        offset = next;
+    }
+    return offset == size;
+}
+
+// Private method that adds the block chunk at chunkOffset, after checking that it fits in the file
+bool CaptureFile::addBlock(qint64 chunkOffset)
+{
+    CaptureChunkHeader chunk;
+    CaptureBlockHeader header;
+    if (chunkOffset < 0 || chunkOffset + qint64(sizeof(chunk) + sizeof(header)) > size)
+    {
+        return false;
+    }
+    std::memcpy(&chunk, map + chunkOffset, sizeof(chunk));
+    std::memcpy(&header, map + chunkOffset + sizeof(chunk), sizeof(header));
+    const qint64 summariesSize = qint64(channelCount()) * qint64(sizeof(CaptureBlockSummary));
+    const qint64 expected = qint64(sizeof(header)) + summariesSize
+                            + qint64(header.frameCount) * qint64(sizeof(qint64) + channelCount() * sizeof(double));
+    if (chunk.type != Capture::ChunkBlock || chunk.size != expected || header.frameCount == 0
+        || chunkOffset + qint64(sizeof(chunk)) + expected > size)
+    {
+        return false;
+    }
+    // times must keep increasing from one block to the next
+    if (!blocks.isEmpty() && header.firstTime < blocks.last().lastTime)
+    {
+        return false;
+    }
+
+    Block block;
+    block.summaryOffset = chunkOffset + qint64(sizeof(chunk) + sizeof(header));
+    block.dataOffset = chunkOffset + qint64(sizeof(chunk) + sizeof(header)) + summariesSize;
+    block.firstFrame = totalFrames;
+    block.firstTime = header.firstTime;
+    block.lastTime = header.lastTime;
+    block.frames = header.frameCount;
+    blocks.append(block);
+    totalFrames += header.frameCount;
+    return true;
+}
+
+const qint64 *CaptureFile::times(const Block &block) const
+{
+    return reinterpret_cast<const qint64 *>(map + block.dataOffset);
+}
+
+const double *CaptureFile::values(const Block &block, int channel) const
+{
+    return reinterpret_cast<const double *>(map + block.dataOffset + qint64(block.frames) * qint64(sizeof(qint64))) + qint64(channel) * block.frames;
+}
+
+const CaptureBlockSummary *CaptureFile::summary(const Block &block, int channel) const
+{
+    return reinterpret_cast<const CaptureBlockSummary *>(map + block.summaryOffset) + channel;
+}
+
+// Private method that returns the block holding frame (binary search on firstFrame)
+int CaptureFile::blockOf(qint64 frame) const
+{
+    int lo = 0, hi = blocks.size() - 1;
+    while (lo < hi)
+    {
+        const int mid = (lo + hi + 1) / 2;
+        if (blocks[mid].firstFrame <= frame)
+        {
+            lo = mid;
+        } else
+        {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+qint64 CaptureFile::findBegin(qint64 time, bool expandedRange) const
+{
+    // first block whose last time is >= time, then first frame in it with time >= time
+    int lo = 0, hi = blocks.size();
+    while (lo < hi)
+    {
+        const int mid = (lo + hi) / 2;
+        if (blocks[mid].lastTime < time) lo = mid + 1; else hi = mid;
+    }
+    qint64 frame = totalFrames;
+    if (lo < blocks.size())
+    {
+        const Block &block = blocks[lo];
+        const qint64 *t = times(block);
+        frame = block.firstFrame + (std::lower_bound(t, t + block.frames, time) - t);
+    }
+    if (expandedRange && frame > 0)
+    {
+        --frame;
+    }
+    return frame;
+}
+
+qint64 CaptureFile::findEnd(qint64 time, bool expandedRange) const
+{
+    // first block whose last time is > time, then first frame in it with time > time
+    int lo = 0, hi = blocks.size();
+    while (lo < hi)
+    {
+        const int mid = (lo + hi) / 2;
+        if (blocks[mid].lastTime <= time) lo = mid + 1; else hi = mid;
+    }
+    qint64 frame = totalFrames;
+    if (lo < blocks.size())
+    {
+        const Block &block = blocks[lo];
+        const qint64 *t = times(block);
+        frame = block.firstFrame + (std::upper_bound(t, t + block.frames, time) - t);
+    }
+    if (expandedRange && frame < totalFrames)
+    {
+        ++frame;
+    }
+    return frame;
+}
+
+void CaptureFile::read(int channel, qint64 begin, qint64 end, int maxPoints, qint64 keyOrigin, QVector<QCPGraphData> &data) const
+{
+    data.resize(0);
+    begin = qBound(qint64(0), begin, totalFrames);
+    end = qBound(begin, end, totalFrames);
+    if (begin == end || channel < 0 || channel >= channelCount())
+    {
+        return;
+    }
+
+    const qint64 count = end - begin;
+    int b = blockOf(begin);
+
+    if (count <= maxPoints || maxPoints < 4)
+    {
+        // every frame in range
+        data.reserve(int(count));
+        qint64 frame = begin;
+        while (frame < end)
+        {
+            const Block &block = blocks[b];
+            const qint64 *t = times(block);
+            const double *v = values(block, channel);
+            const qint64 last = qMin(end, block.firstFrame + block.frames);
+            for (qint64 i = frame - block.firstFrame; i < last - block.firstFrame; ++i)
+            {
+                data.append(QCPGraphData((t[i] - keyOrigin) * 1e-9, v[i]));
+            }
+            frame = last;
+            ++b;
+        }
+        return;
+    }
+
+    // min and max of each bucket of frames, in the order they occur. Every frame of the bucket
+    // counts: whole blocks through their summaries, blocks cut by the bucket edges frame by frame
+    const qint64 buckets = maxPoints / 2;
+    data.reserve(int(buckets * 2));
+    for (qint64 k = 0; k < buckets; ++k)
+    {
+        const qint64 first = begin + count * k / buckets;
+        const qint64 last = begin + count * (k + 1) / buckets;
+        if (first >= last)
+        {
+            continue;
+        }
+        while (blocks[b].firstFrame + blocks[b].frames <= first)
+        {
+            ++b;
+        }
+
+        double minValue = std::numeric_limits<double>::quiet_NaN(), maxValue = minValue;
+        qint64 minTime = 0, maxTime = 0;
+        for (int mb = b; mb < blocks.size() && blocks[mb].firstFrame < last; ++mb)
+        {
+            const Block &block = blocks[mb];
+            const qint64 from = qMax(first, block.firstFrame) - block.firstFrame;
+            const qint64 to = qMin(last, block.firstFrame + block.frames) - block.firstFrame;
+            if (from == 0 && to == block.frames)
+            {
+                const CaptureBlockSummary *s = summary(block, channel);
+                includeValue(s->minValue, s->minTime, minValue, minTime, maxValue, maxTime);
+                includeValue(s->maxValue, s->maxTime, minValue, minTime, maxValue, maxTime);
+                continue;
+            }
+            const qint64 *t = times(block);
+            const double *v = values(block, channel);
+            for (qint64 i = from; i < to; ++i)
+            {
+                includeValue(v[i], t[i], minValue, minTime, maxValue, maxTime);
+            }
+        }
+        if (qIsNaN(minValue))
+        {
+            // keep the gap of a bucket with no valid value
+            data.append(QCPGraphData((times(blocks[b])[first - blocks[b].firstFrame] - keyOrigin) * 1e-9, minValue));
+        } else if (minTime <= maxTime)
+        {
+            data.append(QCPGraphData((minTime - keyOrigin) * 1e-9, minValue));
+            data.append(QCPGraphData((maxTime - keyOrigin) * 1e-9, maxValue));
+        } else
+        {
+            data.append(QCPGraphData((maxTime - keyOrigin) * 1e-9, maxValue));
+            data.append(QCPGraphData((minTime - keyOrigin) * 1e-9, minValue));
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef CAPTUREFILE_H
+#define CAPTUREFILE_H
+
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "captureformat.h"
+#include "qcustomplot.h"
+
+// Definition of the class that reads capture files (see captureformat.h)
+//
+// The file is memory-mapped instead of being loaded, so opening it only reads its header and
+// the headers of its chunks (through the index chunks when the file was closed properly, or by
+// walking the chunks of an interrupted recording). Data is then read on demand for a time range:
+// binary searches over the blocks and within their time column locate the range (with the same
+// semantics as QCPDataContainer::findBegin/findEnd), so only the pages of the file that hold
+// that range are ever touched.
+class CaptureFile
+{
+public:
+    CaptureFile();
+    ~CaptureFile();
+
+    bool open(const QString &fileName);
+
+    void close();
+
+    bool isOpen() const { return map != nullptr; }
+
+    QString errorString() const { return error; }
+
+    int channelCount() const { return channelNames.size(); }
+
+    QString channelName(int channel) const { return channelNames.at(channel); }
+
+    qint64 frameCount() const { return totalFrames; }
+
+    // Timestamps (ns) of the first and last frames
+    qint64 firstTime() const;
+
+    qint64 lastTime() const;
+
+    // Wall clock time (ms since epoch, UTC) of timestamp 0
+    qint64 startTime() const { return wallClock; }
+
+    // Index of the first frame with time >= time, minus one when expandedRange is true
+    qint64 findBegin(qint64 time, bool expandedRange = true) const;
+
+    // Index of the first frame with time > time, plus one when expandedRange is true
+    qint64 findEnd(qint64 time, bool expandedRange = true) const;
+
+    // Replaces data by the frames of channel in [begin, end), with keys in seconds relative to
+    // keyOrigin (ns). If there are more than maxPoints frames, they are reduced to the minimum and
+    // maximum of each of maxPoints / 2 buckets, so spikes and dropouts stay visible at any zoom.
+    // The blocks lying entirely inside a bucket are taken from their summaries, only the blocks
+    // cut by the bucket edges are read frame by frame
+    void read(int channel, qint64 begin, qint64 end, int maxPoints, qint64 keyOrigin, QVector<QCPGraphData> &data) const;
+
+private:
+    struct Block
+    {
+        qint64 summaryOffset;   // file offset of the channel summaries
+        qint64 dataOffset;      // file offset of the time column
+        qint64 firstFrame;      // index of the first frame of the block in the whole file
+        qint64 firstTime;
+        qint64 lastTime;
+        quint32 frames;
+    };
+
+    bool readIndexes(qint64 trailerOffset);
+
+    bool scanChunks(qint64 offset);
+
+    bool addBlock(qint64 chunkOffset);
+
+    int blockOf(qint64 frame) const;
+
+    const qint64 *times(const Block &block) const;
+
+    const double *values(const Block &block, int channel) const;
+
+    const CaptureBlockSummary *summary(const Block &block, int channel) const;
+
+    QFile file;
+
+    uchar *map;
+
+    qint64 size;
+
+    qint64 wallClock;
+
+    qint64 totalFrames;
+
+    QStringList channelNames;
+
+    QVector<Block> blocks;
+
+    QString error;
+};
+
+#endif // CAPTUREFILE_H
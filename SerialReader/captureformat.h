@@ -0,0 +1,106 @@
+#ifndef CAPTUREFORMAT_H
+#define CAPTUREFORMAT_H
+
+#include <QtGlobal>
+
+// Layout of the binary capture files written in record mode (*.srcap)
+//
+// A capture file starts with a CaptureFileHeader followed by the metadata of every channel
+// (CaptureChannelInfo). The rest of the file is a sequence of chunks, each one starting with a
+// CaptureChunkHeader giving its type and the size of its payload:
+//
+// - Block chunks hold a CaptureBlockHeader, one CaptureBlockSummary per channel, then the data of
+//   frameCount frames, stored by columns: frameCount timestamps (qint64, nanoseconds), then
+//   frameCount values (double) for the first channel, frameCount values for the second one, and so
+//   on. Blocks hold up to blockFrames frames (they are written before being full when data arrives
+//   slowly). The summaries let readers draw zoomed out views without reading the values.
+// - Index chunks are written every few blocks. They hold a CaptureIndexHeader followed by one
+//   CaptureIndexEntry per block written since the previous index, and point to that previous index,
+//   so all blocks can be located without reading the data.
+// - A trailer chunk (CaptureTrailer) closes the file and points to the last index.
+//
+// Since every chunk is self-describing, a file whose writing was interrupted (e.g. a crash)
+// can still be read block by block up to its last complete chunk.
+//
+// All values are written in the byte order of the host; byteOrderMark tells readers which one it is.
+namespace Capture
+{
+    const char Magic[8] = {'S', 'R', 'C', 'A', 'P', 'T', 'R', '1'};
+
+    const quint32 Version = 1;
+
+    const quint32 ByteOrderMark = 0x01020304;
+
+    const quint32 ChunkBlock = 0x4B434C42;      // "BLCK"
+    const quint32 ChunkIndex = 0x58444E49;      // "INDX"
+    const quint32 ChunkTrailer = 0x524C5254;    // "TRLR"
+
+    // Frames per block, and blocks between two index chunks
+    const quint32 DefaultBlockFrames = 4096;
+    const int BlocksPerIndex = 64;
+}
+
+struct CaptureFileHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 byteOrderMark;
+    quint32 channelCount;
+    quint32 blockFrames;
+    // wall clock time (ms since epoch, UTC) corresponding to timestamp 0
+    qint64 startTime;
+};
+
+struct CaptureChannelInfo
+{
+    char name[56];      // UTF-8, zero padded
+    double scale;       // unit of the values (1 if they are plain numbers)
+};
+
+struct CaptureChunkHeader
+{
+    quint32 type;
+    quint32 size;       // bytes of payload following this header
+};
+
+struct CaptureBlockHeader
+{
+    quint32 frameCount;
+    quint32 reserved;
+    qint64 firstTime;
+    qint64 lastTime;
+};
+
+// Extremes of the values of a channel in a block, with the times they occur at.
+// NaN values are ignored; both extremes are NaN if the block has no other value
+struct CaptureBlockSummary
+{
+    double minValue;
+    double maxValue;
+    qint64 minTime;
+    qint64 maxTime;
+};
+
+struct CaptureIndexHeader
+{
+    quint32 entryCount;
+    quint32 reserved;
+    qint64 previousIndex;   // file offset of the previous index chunk, -1 for the first one
+};
+
+struct CaptureIndexEntry
+{
+    qint64 offset;          // file offset of the block chunk (its CaptureChunkHeader)
+    qint64 firstTime;
+    qint64 lastTime;
+    quint32 frameCount;
+    quint32 reserved;
+};
+
+struct CaptureTrailer
+{
+    qint64 lastIndex;       // file offset of the last index chunk, -1 if there is none
+    qint64 totalFrames;
+};
+
+#endif // CAPTUREFORMAT_H
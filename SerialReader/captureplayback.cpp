@@ -0,0 +1,96 @@
+// Definition of methods for the CapturePlayback class
+
+#include "captureplayback.h"
+
+#include <limits>
+
+
+namespace {
+
+// Points read per pixel of the axis rect (min and max of every half pixel)
+const int pointsPerPixel = 4;
+
+}
+
+// Constructor of the CapturePlayback class
+CapturePlayback::CapturePlayback(QCustomPlot *plot, QObject *parent)
+    : QObject(parent)
+    , plot(plot)
+    , density(0)
+{
+    QObject::connect(plot->xAxis, QOverload<const QCPRange &>::of(&QCPAxis::rangeChanged), this, &CapturePlayback::onRangeChanged);
+}
+
+double CapturePlayback::duration() const
+{
+    return (file.lastTime() - file.firstTime()) * 1e-9;
+}
+
+// Public method that opens a capture file and sets up one graph per channel of it.
+// The x axis is set to the whole capture, which loads its overview
+bool CapturePlayback::open(const QString &fileName)
+{
+    if (!file.open(fileName))
+    {
+        return false;
+    }
+
+    plot->clearGraphs();
+    const bool multiChannel = file.channelCount() > 1;
+    for (int i = 0; i < file.channelCount(); ++i)
+    {
+        QCPGraph *graph = plot->addGraph();
+        graph->setName(file.channelName(i).isEmpty() ? QString("Channel %1").arg(i + 1) : file.channelName(i));
+        graph->setPen(QPen(multiChannel ? QColor::fromHsv((i * 360 / file.channelCount()) % 360, 220, 200) : QColor(Qt::blue)));
+    }
+    plot->legend->setVisible(multiChannel);
+
+    loaded = QCPRange(0, 0);
+    density = 0;
+    plot->xAxis->setRange(0, qMax(duration(), 1e-3));
+    load(plot->xAxis->range());
+    plot->rescaleAxes(true);
+    plot->yAxis->scaleRange(1.1);
+    plot->replot(QCustomPlot::rpQueuedReplot);
+    return true;
+}
+
+// Private method (slot) called whenever the x axis range changes (pan, zoom or setRange)
+//
+// The graphs are only reloaded when the new range isn't covered by the loaded one, or when it has
+// been zoomed in enough that the loaded points are too sparse for it
+void CapturePlayback::onRangeChanged(const QCPRange &range)
+{
+    const int pixels = qMax(1, plot->axisRect()->width());
+    const double needed = pixels * pointsPerPixel / qMax(range.size(), 1e-12);
+    if (range.lower >= loaded.lower && range.upper <= loaded.upper && density >= needed / 2)
+    {
+        return;
+    }
+    load(range);
+}
+
+// Private method that reads the visible range, plus half its width on each side so that small
+// pans don't need a reload, into the graphs
+void CapturePlayback::load(const QCPRange &range)
+{
+    if (!file.isOpen())
+    {
+        return;
+    }
+
+    const double margin = range.size() / 2;
+    loaded = QCPRange(range.lower - margin, range.upper + margin);
+    const int maxPoints = qMax(1, plot->axisRect()->width()) * pointsPerPixel * 2;
+
+    const qint64 origin = file.firstTime();
+    const qint64 begin = file.findBegin(origin + qint64(loaded.lower * 1e9));
+    const qint64 end = file.findEnd(origin + qint64(loaded.upper * 1e9));
+    // when every frame in range fits, zooming in further never needs a reload
+    density = end - begin <= maxPoints ? std::numeric_limits<double>::infinity() : maxPoints / loaded.size();
+    for (int c = 0; c < file.channelCount() && c < plot->graphCount(); ++c)
+    {
+        file.read(c, begin, end, maxPoints, origin, buffer);
+        plot->graph(c)->data()->set(buffer, true);
+    }
+}
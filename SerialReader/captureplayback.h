@@ -0,0 +1,51 @@
+#ifndef CAPTUREPLAYBACK_H
+#define CAPTUREPLAYBACK_H
+
+#include <QObject>
+
+#include "capturefile.h"
+#include "qcustomplot.h"
+
+// Definition of the class that shows a capture file in a QCustomPlot
+//
+// The graphs only ever hold the part of the capture around the visible x range, decimated to a
+// few points per pixel. Every time the x axis is panned or zoomed out of the loaded part (or
+// zoomed enough to need more detail), that part is read again from the memory-mapped file, so
+// seeking anywhere in a capture of any size costs the same.
+// Keys are in seconds since the first frame of the capture, as in live acquisition.
+class CapturePlayback : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CapturePlayback(QCustomPlot *plot, QObject *parent = nullptr);
+
+    // Opens fileName and shows its whole span. Returns false (see errorString()) on failure
+    bool open(const QString &fileName);
+
+    QString errorString() const { return file.errorString(); }
+
+    const CaptureFile &capture() const { return file; }
+
+    // Duration of the capture in seconds
+    double duration() const;
+
+private slots:
+    void onRangeChanged(const QCPRange &range);
+
+private:
+    void load(const QCPRange &range);
+
+    QCustomPlot *plot;
+
+    CaptureFile file;
+
+    // Range of keys currently held by the graphs and the points per second they were read with
+    QCPRange loaded;
+
+    double density;
+
+    QVector<QCPGraphData> buffer;
+};
+
+#endif // CAPTUREPLAYBACK_H
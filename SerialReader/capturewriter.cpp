@@ -0,0 +1,321 @@
+// Definition of methods for the CaptureWriter class
+
+#include "capturewriter.h"
+
+#include <QMutexLocker>
+#include <QtNumeric>
+#include <cstring>
+#include <limits>
+
+
+namespace {
+
+// A block that isn't full is written anyway after this time (in ms), so slow data reaches the disk
+const qint64 maxBlockAge = 1000;
+
+}
+
+// Constructor of the CaptureWriter class
+CaptureWriter::CaptureWriter(QObject *parent)
+    : QThread(parent)
+    , startTime(0)
+    , blockFrames(Capture::DefaultBlockFrames)
+    , channels(0)
+    , front(&blocks[0])
+    , back(&blocks[1])
+    , backReady(false)
+    , stopping(false)
+    , failed(false)
+    , previousIndex(-1)
+    , totalFrames(0)
+{
+}
+
+// Destructor of the CaptureWriter class
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+bool CaptureWriter::open(const QString &fileName, qint64 startTime, quint32 blockFrames)
+{
+    close();
+
+    file.setFileName(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        return false;
+    }
+
+    this->startTime = startTime;
+    this->blockFrames = qMax(blockFrames, 1u);
+    channels = 0;
+    front->frames = 0;
+    back->frames = 0;
+    backReady = false;
+    stopping = false;
+    failed = false;
+    header.clear();
+    indexEntries.clear();
+    previousIndex = -1;
+    totalFrames.store(0, std::memory_order_relaxed);
+
+    start();
+    return true;
+}
+
+void CaptureWriter::close()
+{
+    if (!isRunning())
+    {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&mutex);
+        if (front->frames > 0)
+        {
+            submit();
+        }
+        stopping = true;
+        blockReady.wakeOne();
+    }
+    wait();
+}
+
+// Private method, called on the first frame with the mutex locked, that sets up the blocks and
+// the file header for count channels
+void CaptureWriter::begin(int count)
+{
+    channels = count;
+    for (int i = 0; i < 2; ++i)
+    {
+        blocks[i].times.assign(blockFrames, 0);
+        blocks[i].values.assign(std::size_t(blockFrames) * std::size_t(channels), 0.0);
+        blocks[i].frames = 0;
+    }
+
+    CaptureFileHeader fileHeader;
+    std::memcpy(fileHeader.magic, Capture::Magic, sizeof(fileHeader.magic));
+    fileHeader.version = Capture::Version;
+    fileHeader.byteOrderMark = Capture::ByteOrderMark;
+    fileHeader.channelCount = quint32(channels);
+    fileHeader.blockFrames = blockFrames;
+    fileHeader.startTime = startTime;
+    header = QByteArray(reinterpret_cast<const char *>(&fileHeader), sizeof(fileHeader));
+
+    for (int c = 0; c < channels; ++c)
+    {
+        CaptureChannelInfo info;
+        std::memset(&info, 0, sizeof(info));
+        const QByteArray name = QString("Channel %1").arg(c + 1).toUtf8();
+        std::memcpy(info.name, name.constData(), qMin(std::size_t(name.size()), sizeof(info.name) - 1));
+        info.scale = 1.0;
+        header.append(reinterpret_cast<const char *>(&info), sizeof(info));
+    }
+}
+
+void CaptureWriter::append(qint64 time, const double *values, int count)
+{
+    // the writer thread may swap the front block once it is old enough and reads the blocks and
+    // the header set up by begin(), so they are filled under the mutex (uncontended but for the swaps)
+    QMutexLocker locker(&mutex);
+    if (channels == 0)
+    {
+        if (count <= 0)
+        {
+            return;
+        }
+        begin(count);
+    }
+
+    Block *block = front;
+    const quint32 row = block->frames;
+    if (row == 0)
+    {
+        // the writer thread now waits for the block to get old
+        frontAge.start();
+        blockReady.wakeOne();
+    }
+    block->times[row] = time;
+    for (int c = 0; c < channels; ++c)
+    {
+        block->values[std::size_t(c) * blockFrames + row] = c < count ? values[c] : std::numeric_limits<double>::quiet_NaN();
+    }
+    block->frames = row + 1;
+
+    if (block->frames == blockFrames)
+    {
+        submit();
+    }
+}
+
+// Private method, called with the mutex locked, that hands the front block over to the writer
+// thread and starts filling the other one. If the writer is still busy with the other block,
+// it waits for it to finish
+void CaptureWriter::submit()
+{
+    while (backReady && !failed)
+    {
+        blockWritten.wait(&mutex);
+    }
+    if (failed)
+    {
+        front->frames = 0;
+        return;
+    }
+    std::swap(front, back);
+    front->frames = 0;
+    backReady = true;
+    blockReady.wakeOne();
+}
+
+// Writer thread: writes every submitted block, and the index and trailer once closing
+//
+// While the front block holds frames, it waits with a timeout, and writes the block itself
+// once it has been pending for maxBlockAge, so partial blocks reach the disk even if no frame follows
+void CaptureWriter::run()
+{
+    forever
+    {
+        QMutexLocker locker(&mutex);
+        while (!backReady && !stopping)
+        {
+            if (front->frames == 0 || failed)
+            {
+                blockReady.wait(&mutex);
+            } else if (frontAge.hasExpired(maxBlockAge))
+            {
+                std::swap(front, back);
+                front->frames = 0;
+                backReady = true;
+            } else
+            {
+                blockReady.wait(&mutex, static_cast<unsigned long>(maxBlockAge - frontAge.elapsed()));
+            }
+        }
+        if (!backReady)
+        {
+            break;
+        }
+        locker.unlock();
+
+        // the producer never touches the back block while backReady is set
+        bool ok = failed || writeBlock(*back);
+
+        locker.relock();
+        if (!ok && !failed)
+        {
+            failed = true;
+            emit error(file.errorString());
+        }
+        backReady = false;
+        blockWritten.wakeAll();
+    }
+
+    if (!failed && channels > 0)
+    {
+        CaptureChunkHeader chunk = {Capture::ChunkTrailer, sizeof(CaptureTrailer)};
+        bool ok = indexEntries.isEmpty() || writeIndex();
+        CaptureTrailer trailer = {previousIndex, totalFrames.load(std::memory_order_relaxed)};
+        ok = ok && write(&chunk, sizeof(chunk)) && write(&trailer, sizeof(trailer));
+        if (!ok)
+        {
+            emit error(file.errorString());
+        }
+    }
+    if (channels == 0)
+    {
+        // without a frame, not even the header was written: no file is better than an unreadable one
+        file.remove();
+    } else
+    {
+        file.close();
+    }
+}
+
+bool CaptureWriter::write(const void *data, qint64 size)
+{
+    return file.write(static_cast<const char *>(data), size) == size;
+}
+
+// Private method (writer thread) that writes a block chunk and, every BlocksPerIndex blocks, an index
+bool CaptureWriter::writeBlock(const Block &block)
+{
+    if (!header.isEmpty())
+    {
+        if (!write(header.constData(), header.size()))
+        {
+            return false;
+        }
+        header.clear();
+    }
+
+    const qint64 frames = block.frames;
+    CaptureIndexEntry entry;
+    entry.offset = file.pos();
+    entry.firstTime = block.times[0];
+    entry.lastTime = block.times[block.frames - 1];
+    entry.frameCount = block.frames;
+    entry.reserved = 0;
+
+    // extremes of every channel, so that readers can draw the block zoomed out without its values
+    QVector<CaptureBlockSummary> summaries(channels);
+    for (int c = 0; c < channels; ++c)
+    {
+        const double *v = block.values.data() + std::size_t(c) * blockFrames;
+        CaptureBlockSummary &summary = summaries[c];
+        summary.minValue = std::numeric_limits<double>::quiet_NaN();
+        summary.maxValue = summary.minValue;
+        summary.minTime = entry.firstTime;
+        summary.maxTime = entry.firstTime;
+        for (qint64 i = 0; i < frames; ++i)
+        {
+            if (qIsNaN(v[i]))
+            {
+                continue;
+            }
+            if (!(v[i] >= summary.minValue)) { summary.minValue = v[i]; summary.minTime = block.times[i]; }
+            if (!(v[i] <= summary.maxValue)) { summary.maxValue = v[i]; summary.maxTime = block.times[i]; }
+        }
+    }
+
+    CaptureChunkHeader chunk;
+    chunk.type = Capture::ChunkBlock;
+    chunk.size = quint32(sizeof(CaptureBlockHeader) + channels * sizeof(CaptureBlockSummary) + frames * sizeof(qint64)
+                         + frames * channels * sizeof(double));
+    CaptureBlockHeader blockHeader = {block.frames, 0, entry.firstTime, entry.lastTime};
+
+    bool ok = write(&chunk, sizeof(chunk)) && write(&blockHeader, sizeof(blockHeader))
+              && write(summaries.constData(), channels * qint64(sizeof(CaptureBlockSummary)))
+              && write(block.times.data(), frames * qint64(sizeof(qint64)));
+    for (int c = 0; c < channels && ok; ++c)
+    {
+        ok = write(block.values.data() + std::size_t(c) * blockFrames, frames * qint64(sizeof(double)));
+    }
+
+    indexEntries.append(entry);
+    if (ok && indexEntries.size() >= Capture::BlocksPerIndex)
+    {
+        ok = writeIndex();
+    }
+    ok = ok && file.flush();
+    totalFrames.fetch_add(frames, std::memory_order_relaxed);
+    return ok;
+}
+
+// Private method (writer thread) that writes an index chunk for the blocks written since the last one
+bool CaptureWriter::writeIndex()
+{
+    const qint64 offset = file.pos();
+    CaptureChunkHeader chunk;
+    chunk.type = Capture::ChunkIndex;
+    chunk.size = quint32(sizeof(CaptureIndexHeader) + indexEntries.size() * sizeof(CaptureIndexEntry));
+    CaptureIndexHeader indexHeader = {quint32(indexEntries.size()), 0, previousIndex};
+
+    const bool ok = write(&chunk, sizeof(chunk)) && write(&indexHeader, sizeof(indexHeader))
+                    && write(indexEntries.constData(), indexEntries.size() * qint64(sizeof(CaptureIndexEntry)));
+    previousIndex = offset;
+    indexEntries.clear();
+    return ok;
+}
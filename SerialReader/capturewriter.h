@@ -0,0 +1,114 @@
+#ifndef CAPTUREWRITER_H
+#define CAPTUREWRITER_H
+
+#include <QThread>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <atomic>
+#include <vector>
+
+#include "captureformat.h"
+
+// Definition of the class that records samples to a capture file (see captureformat.h)
+//
+// The acquisition thread appends frames to a front block in memory. When the block is full
+// it is swapped with the back block, which this thread writes to disk while the front one keeps
+// filling up. This thread also swaps a block that has been pending for a second, even if no frame
+// follows (e.g. the device went quiet). Memory use is thus constant (two blocks)
+// whatever the length of the recording, and the acquisition thread only waits if the disk is
+// slower than the incoming data. Every block is flushed to the file as soon as it is written,
+// so a recording interrupted by a crash keeps all blocks but the last two.
+class CaptureWriter : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit CaptureWriter(QObject *parent = nullptr);
+    ~CaptureWriter();
+
+    // Creates the file and starts the writer thread. startTime is the wall clock time
+    // (ms since epoch, UTC) of timestamp 0. Returns false if the file can't be created
+    bool open(const QString &fileName, qint64 startTime, quint32 blockFrames = Capture::DefaultBlockFrames);
+
+    // Writes the frames still in memory, the last index and the trailer, and closes the file.
+    // A recording without any frame has no header, and its file is removed
+    void close();
+
+    // To be called by a single (acquisition) thread. The number of channels of the recording
+    // is that of the first frame: the following ones are padded with NaN or cut to it
+    void append(qint64 time, const double *values, int count);
+
+    QString errorString() const { return file.errorString(); }
+
+    qint64 framesWritten() const { return totalFrames.load(std::memory_order_relaxed); }
+
+signals:
+    // Emitted (from the writer thread) if writing to the file fails. Recording stops
+    void error(const QString &message);
+
+protected:
+    void run() override;
+
+private:
+    struct Block
+    {
+        std::vector<qint64> times;
+        std::vector<double> values;     // channel c starts at values[c * blockFrames]
+        quint32 frames;
+    };
+
+    void begin(int count);
+
+    void submit();
+
+    bool write(const void *data, qint64 size);
+
+    bool writeBlock(const Block &block);
+
+    bool writeIndex();
+
+    QFile file;
+
+    qint64 startTime;
+
+    quint32 blockFrames;
+
+    int channels;
+
+    Block blocks[2];
+
+    Block *front;
+
+    Block *back;
+
+    // Started when the front block receives its first frame
+    QElapsedTimer frontAge;
+
+    QMutex mutex;
+
+    QWaitCondition blockReady;
+
+    QWaitCondition blockWritten;
+
+    bool backReady;
+
+    bool stopping;
+
+    bool failed;
+
+    // File header and channel metadata, written by the writer thread before the first block
+    QByteArray header;
+
+    QVector<CaptureIndexEntry> indexEntries;
+
+    qint64 previousIndex;
+
+    std::atomic<qint64> totalFrames;
+};
+
+#endif // CAPTUREWRITER_H
@@ -0,0 +1,48 @@
+// Definition of methods for the ChannelBuffer class
+
+#include "channelbuffer.h"
+
+#include <limits>
+
+
+// Constructor of the ChannelBuffer class
+ChannelBuffer::ChannelBuffer()
+{
+}
+
+void ChannelBuffer::append(double x, const double *values, int count)
+{
+    if (count > columns.size())
+    {
+        setChannelCount(count);
+    }
+
+    time.append(x);
+    for (int i = 0; i < count; ++i)
+    {
+        columns[i].append(values[i]);
+    }
+    for (int i = count; i < columns.size(); ++i)
+    {
+        columns[i].append(std::numeric_limits<double>::quiet_NaN());
+    }
+}
+
+void ChannelBuffer::clear()
+{
+    time.resize(0);
+    for (int i = 0; i < columns.size(); ++i)
+    {
+        columns[i].resize(0);
+    }
+}
+
+void ChannelBuffer::setChannelCount(int count)
+{
+    const int previous = columns.size();
+    columns.resize(count);
+    for (int i = previous; i < count; ++i)
+    {
+        columns[i].fill(std::numeric_limits<double>::quiet_NaN(), time.size());
+    }
+}
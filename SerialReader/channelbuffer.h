@@ -0,0 +1,40 @@
+#ifndef CHANNELBUFFER_H
+#define CHANNELBUFFER_H
+
+#include <QVector>
+
+// Definition of the class that stores multi-channel data as a structure of arrays
+//
+// All channels share a single time column, and each channel has its own column of values,
+// so a whole channel can be handed to a QCPGraph in one call without any reshuffling.
+class ChannelBuffer
+{
+public:
+    ChannelBuffer();
+
+    int channelCount() const { return columns.size(); }
+
+    int size() const { return time.size(); }
+
+    bool isEmpty() const { return time.isEmpty(); }
+
+    // Appends a row. Missing channels are stored as NaN and new channels are created
+    // (padded with NaN for the previous rows) if count exceeds channelCount()
+    void append(double x, const double *values, int count);
+
+    // Removes all rows but keeps the channels and the allocated memory
+    void clear();
+
+    const QVector<double> &keys() const { return time; }
+
+    const QVector<double> &column(int channel) const { return columns[channel]; }
+
+private:
+    void setChannelCount(int count);
+
+    QVector<double> time;
+
+    QVector<QVector<double> > columns;
+};
+
+#endif // CHANNELBUFFER_H
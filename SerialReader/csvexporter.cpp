@@ -0,0 +1,177 @@
+// Definition of methods for the CsvExporter class
+
+#include "csvexporter.h"
+#include "numberformat.h"
+
+#include <QFile>
+#include <limits>
+#include <vector>
+
+
+namespace {
+
+// Size of the buffer rows are formatted into before being written to the file
+const int bufferSize = 1 << 20;
+
+// Significant digits written for times and values
+const int timeDigits = 12;
+
+const int valueDigits = 10;
+
+}
+
+// Constructor of the CsvExporter class
+CsvExporter::CsvExporter(const QString &fileName, const QVector<QVector<QCPGraphDataContainer> > &snapshot,
+                         const QStringList &groupNames, QObject *parent)
+    : QObject(parent)
+    , fileName(fileName)
+    , snapshot(snapshot)
+    , groupNames(groupNames)
+    , cancelled(false)
+{
+}
+
+void CsvExporter::cancel()
+{
+    cancelled.store(true, std::memory_order_relaxed);
+}
+
+// Public slot that writes the file: one row per time, one column per channel
+//
+// All graphs of a group hold the same keys (missing values are NaN), so the time column of a
+// group is taken from its first graph. Every row is written at the smallest key of the groups
+// not written yet, taking the values of every group at that key
+void CsvExporter::run()
+{
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        emit finished(false, file.errorString());
+        return;
+    }
+
+    const int groups = snapshot.size();
+    int channels = 0;
+    qint64 rows = 0;
+    QVector<QVector<QCPGraphDataContainer::const_iterator> > columns(groups);
+    QVector<QCPGraphDataContainer::const_iterator> ends(groups);
+    for (int g = 0; g < groups; ++g)
+    {
+        for (int c = 0; c < snapshot.at(g).size(); ++c)
+        {
+            columns[g].append(snapshot.at(g).at(c).constBegin());
+        }
+        if (!columns[g].isEmpty())
+        {
+            ends[g] = snapshot.at(g).at(0).constEnd();
+            rows += snapshot.at(g).at(0).size();
+        }
+        channels += columns[g].size();
+    }
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    std::vector<char> buffer(bufferSize);
+    char *p = buffer.data();
+    // one row never takes more than this many bytes
+    const std::size_t maxRowSize = std::size_t(channels + 1) * 33 + 1;
+    if (maxRowSize > buffer.size())
+    {
+        buffer.resize(maxRowSize);
+        p = buffer.data();
+    }
+
+    QByteArray header = "Time (s)";
+    for (int g = 0; g < groups; ++g)
+    {
+        for (int c = 0; c < columns[g].size(); ++c)
+        {
+            if (groups > 1)
+            {
+                header += "," + groupNames.value(g).toUtf8() + " channel " + QByteArray::number(c + 1);
+            } else
+            {
+                header += ",Channel " + QByteArray::number(c + 1);
+            }
+        }
+    }
+    header += "\n";
+    bool ok = file.write(header) == header.size();
+
+    int lastPercent = -1;
+    qint64 written = 0;
+    while (ok)
+    {
+        if (cancelled.load(std::memory_order_relaxed))
+        {
+            break;
+        }
+
+        double key = std::numeric_limits<double>::infinity();
+        bool done = true;
+        for (int g = 0; g < groups; ++g)
+        {
+            if (!columns[g].isEmpty() && columns[g][0] != ends[g])
+            {
+                key = qMin(key, columns[g][0]->key);
+                done = false;
+            }
+        }
+        if (done)
+        {
+            break;
+        }
+
+        p += formatDouble(key, timeDigits, p);
+        for (int g = 0; g < groups; ++g)
+        {
+            const bool present = !columns[g].isEmpty() && columns[g][0] != ends[g] && columns[g][0]->key == key;
+            for (int c = 0; c < columns[g].size(); ++c)
+            {
+                *p++ = ',';
+                if (present)
+                {
+                    p += formatDouble(columns[g][c]->value, valueDigits, p);
+                    ++columns[g][c];
+                } else
+                {
+                    p += formatDouble(nan, valueDigits, p);
+                }
+            }
+            written += present ? 1 : 0;
+        }
+        *p++ = '\n';
+
+        if (std::size_t(buffer.data() + buffer.size() - p) < maxRowSize)
+        {
+            ok = file.write(buffer.data(), p - buffer.data()) == p - buffer.data();
+            p = buffer.data();
+
+            const int percent = int(written * 100 / rows);
+            if (percent != lastPercent)
+            {
+                lastPercent = percent;
+                emit progress(percent);
+            }
+        }
+    }
+    if (ok && p != buffer.data())
+    {
+        ok = file.write(buffer.data(), p - buffer.data()) == p - buffer.data();
+    }
+
+    if (!ok)
+    {
+        const QString error = file.errorString();
+        file.remove();
+        emit finished(false, error);
+    } else if (cancelled.load(std::memory_order_relaxed))
+    {
+        file.remove();
+        emit finished(false, QString());
+    } else
+    {
+        file.close();
+        emit progress(100);
+        emit finished(true, QString());
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef CSVEXPORTER_H
+#define CSVEXPORTER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+
+#include "qcustomplot.h"
+
+// Definition of the class that saves the plotted data in a csv file
+//
+// An instance of this class is meant to be moved to a worker QThread, so the ui stays responsive
+// and acquisition continues while saving. It works on a snapshot of the data containers of the
+// graphs: copying a container is cheap (its storage is implicitly shared) and the copy is never
+// modified, whatever happens to the graphs in the meantime. Rows are formatted with formatDouble()
+// into a large buffer that is written to disk every time it fills up.
+//
+// The graphs come in groups, one per serial port: the graphs of a group hold the same keys, but
+// different ports are sampled at different times. Their rows are merged by time, with NaN in the
+// columns of the ports that have no sample at that time.
+class CsvExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    // groupNames (the port names) label the columns when there are several groups
+    CsvExporter(const QString &fileName, const QVector<QVector<QCPGraphDataContainer> > &snapshot,
+                const QStringList &groupNames, QObject *parent = nullptr);
+
+    // Can be called from any thread. The export stops at the next row and the file is removed
+    void cancel();
+
+public slots:
+    void run();
+
+signals:
+    // percent of rows written
+    void progress(int percent);
+
+    // ok is false if the export failed (error then describes why) or was cancelled
+    void finished(bool ok, const QString &error);
+
+private:
+    QString fileName;
+
+    QVector<QVector<QCPGraphDataContainer> > snapshot;
+
+    QStringList groupNames;
+
+    std::atomic<bool> cancelled;
+};
+
+#endif // CSVEXPORTER_H
@@ -0,0 +1,636 @@
+// Definition of methods for the frame decoders
+
+#include "framedecoder.h"
+
+#include <QtEndian>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+
+namespace {
+
+// Maximum number of columns kept from a line, so garbage without line feeds can't grow a row forever
+const int maxLineColumns = 256;
+
+quint8 crc8(const uchar *data, int size)
+{
+    static const struct Table
+    {
+        Table()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                quint8 c = quint8(i);
+                for (int k = 0; k < 8; ++k)
+                {
+                    c = (c & 0x80) ? quint8((c << 1) ^ 0x07) : quint8(c << 1);
+                }
+                values[i] = c;
+            }
+        }
+        quint8 values[256];
+    } table;
+
+    quint8 crc = 0;
+    for (int i = 0; i < size; ++i)
+    {
+        crc = table.values[crc ^ data[i]];
+    }
+    return crc;
+}
+
+quint16 crc16(const uchar *data, int size)
+{
+    static const struct Table
+    {
+        Table()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                quint16 c = quint16(i << 8);
+                for (int k = 0; k < 8; ++k)
+                {
+                    c = (c & 0x8000) ? quint16((c << 1) ^ 0x1021) : quint16(c << 1);
+                }
+                values[i] = c;
+            }
+        }
+        quint16 values[256];
+    } table;
+
+    quint16 crc = 0xFFFF;
+    for (int i = 0; i < size; ++i)
+    {
+        crc = quint16((crc << 8) ^ table.values[((crc >> 8) ^ data[i]) & 0xFF]);
+    }
+    return crc;
+}
+
+quint32 crc32(const uchar *data, int size)
+{
+    static const struct Table
+    {
+        Table()
+        {
+            for (quint32 i = 0; i < 256; ++i)
+            {
+                quint32 c = i;
+                for (int k = 0; k < 8; ++k)
+                {
+                    c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+                }
+                values[i] = c;
+            }
+        }
+        quint32 values[256];
+    } table;
+
+    quint32 crc = 0xFFFFFFFFu;
+    for (int i = 0; i < size; ++i)
+    {
+        crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+template <typename T>
+T readField(const uchar *src, bool littleEndian)
+{
+    return littleEndian ? qFromLittleEndian<T>(src) : qFromBigEndian<T>(src);
+}
+
+}
+
+
+// Constructor of the DecoderSettings struct: comma separated doubles, as transmitted by our sensors
+DecoderSettings::DecoderSettings()
+    : type(CsvStream)
+    , channels(0)
+    , littleEndian(true)
+    , checksum(NoChecksum)
+    , timeSource(InterpolatedTime)
+    , timestampChannel(0)
+    , timestampScale(1.0)
+{
+}
+
+int DecoderSettings::payloadSize() const
+{
+    int size = 0;
+    for (int i = 0; i < fields.size(); ++i)
+    {
+        size += fieldSize(fields[i]);
+    }
+    return size;
+}
+
+int DecoderSettings::fieldSize(FieldType type)
+{
+    switch (type)
+    {
+    case Int8:
+    case UInt8:
+        return 1;
+    case Int16:
+    case UInt16:
+        return 2;
+    case Int32:
+    case UInt32:
+    case Float32:
+        return 4;
+    case Float64:
+        return 8;
+    }
+    return 0;
+}
+
+int DecoderSettings::checksumSize(Checksum checksum)
+{
+    switch (checksum)
+    {
+    case NoChecksum:
+        return 0;
+    case Crc8:
+        return 1;
+    case Crc16:
+        return 2;
+    case Crc32:
+        return 4;
+    }
+    return 0;
+}
+
+bool DecoderSettings::parseLayout(const QString &text, QVector<FieldType> &fields)
+{
+    static const QStringList names = {"i8", "u8", "i16", "u16", "i32", "u32", "f32", "f64"};
+
+    QVector<FieldType> parsed;
+    for (const QString &token : text.split(','))
+    {
+        if (token.trimmed().isEmpty())
+        {
+            continue;
+        }
+        const int index = names.indexOf(token.trimmed().toLower());
+        if (index < 0)
+        {
+            return false;
+        }
+        parsed.append(FieldType(index));
+    }
+    if (parsed.isEmpty())
+    {
+        return false;
+    }
+    fields = parsed;
+    return true;
+}
+
+bool DecoderSettings::parseSyncBytes(const QString &text, QByteArray &bytes)
+{
+    QString hex = text;
+    hex.remove(' ');
+    const QByteArray parsed = QByteArray::fromHex(hex.toLatin1());
+    if (hex.size() % 2 != 0 || parsed.size() != hex.size() / 2)
+    {
+        return false;
+    }
+    bytes = parsed;
+    return true;
+}
+
+bool DecoderSettings::validate(QString &error) const
+{
+    if (type >= BinaryStruct && fields.isEmpty())
+    {
+        error = "Binary frames need a layout";
+        return false;
+    }
+    // Without sync bytes nor checksum, frames can't be told apart from noise
+    if (type == BinaryStruct && syncBytes.isEmpty() && checksum == NoChecksum)
+    {
+        error = "Binary frames need sync bytes or a checksum";
+        return false;
+    }
+    return true;
+}
+
+// Names of the decoder types, in the order of the Type enum (used to populate the ui)
+QStringList DecoderSettings::typeNames()
+{
+    return {"CSV stream", "CSV lines", "Binary struct", "COBS frames", "SLIP frames"};
+}
+
+
+FrameDecoder *FrameDecoder::create(const DecoderSettings &settings)
+{
+    switch (settings.type)
+    {
+    case DecoderSettings::CsvStream:
+        return new CsvStreamDecoder();
+    case DecoderSettings::CsvLines:
+        return new CsvLinesDecoder(settings.channels);
+    case DecoderSettings::BinaryStruct:
+        return new BinaryStructDecoder(settings);
+    case DecoderSettings::Cobs:
+        return new CobsDecoder(settings);
+    case DecoderSettings::Slip:
+        return new SlipDecoder(settings);
+    }
+    return new CsvStreamDecoder();
+}
+
+
+// Constructor of the CsvStreamDecoder class
+CsvStreamDecoder::CsvStreamDecoder()
+{
+    reset();
+}
+
+void CsvStreamDecoder::reset()
+{
+    parser.reset();
+    skipNext = true;
+}
+
+void CsvStreamDecoder::decodeChunk(const char *data, qint64 size, FrameBatch &batch)
+{
+    batch.channels = 1;
+    Sink sink = {this, &batch};
+    parser.parse(data, size, sink);
+}
+
+// Every number is a frame, except the first one after reset() and tokens that are not numbers
+void CsvStreamDecoder::Sink::value(double v, qint64 position)
+{
+    if (decoder->skipNext)
+    {
+        decoder->skipNext = false;
+    } else if (!std::isnan(v))
+    {
+        batch->values.push_back(v);
+        batch->markEnd(position + 1);
+    }
+}
+
+
+// Constructor of the CsvLinesDecoder class
+CsvLinesDecoder::CsvLinesDecoder(int channels)
+    : configuredChannels(channels)
+{
+    row.reserve(maxLineColumns);
+    reset();
+}
+
+void CsvLinesDecoder::reset()
+{
+    parser.reset();
+    channels = configuredChannels;
+    row.clear();
+    skipLine = true;
+}
+
+void CsvLinesDecoder::decodeChunk(const char *data, qint64 size, FrameBatch &batch)
+{
+    batch.channels = channels;
+    Sink sink = {this, &batch};
+    parser.parse(data, size, sink);
+}
+
+void CsvLinesDecoder::Sink::value(double v, qint64)
+{
+    if (int(decoder->row.size()) < maxLineColumns)
+    {
+        decoder->row.push_back(v);
+    }
+}
+
+// A line feed completes a frame. Its columns are padded with NaN (or cut) to the number of channels,
+// which is taken from the first complete line when it hasn't been configured
+void CsvLinesDecoder::Sink::endOfLine(qint64 position)
+{
+    std::vector<double> &row = decoder->row;
+    if (decoder->skipLine || row.empty())
+    {
+        decoder->skipLine = false;
+        row.clear();
+        return;
+    }
+
+    if (decoder->channels == 0)
+    {
+        decoder->channels = int(row.size());
+        batch->channels = decoder->channels;
+    }
+    row.resize(decoder->channels, std::numeric_limits<double>::quiet_NaN());
+    batch->values.insert(batch->values.end(), row.begin(), row.end());
+    batch->markEnd(position + 1);
+    row.clear();
+}
+
+
+// Constructor of the BinaryLayout class
+BinaryLayout::BinaryLayout(const DecoderSettings &settings)
+    : fields(settings.fields)
+    , littleEndian(settings.littleEndian)
+    , checksum(settings.checksum)
+    , payloadSize(settings.payloadSize())
+    , checksumSize(DecoderSettings::checksumSize(settings.checksum))
+{
+}
+
+bool BinaryLayout::decode(const uchar *payload, FrameBatch &batch) const
+{
+    const uchar *check = payload + payloadSize;
+    switch (checksum)
+    {
+    case DecoderSettings::NoChecksum:
+        break;
+    case DecoderSettings::Crc8:
+        if (crc8(payload, payloadSize) != check[0])
+        {
+            return false;
+        }
+        break;
+    case DecoderSettings::Crc16:
+        if (crc16(payload, payloadSize) != readField<quint16>(check, littleEndian))
+        {
+            return false;
+        }
+        break;
+    case DecoderSettings::Crc32:
+        if (crc32(payload, payloadSize) != readField<quint32>(check, littleEndian))
+        {
+            return false;
+        }
+        break;
+    }
+
+    batch.channels = fields.size();
+    const uchar *src = payload;
+    for (int i = 0; i < fields.size(); ++i)
+    {
+        double value = 0;
+        switch (fields[i])
+        {
+        case DecoderSettings::Int8:
+            value = qint8(*src);
+            break;
+        case DecoderSettings::UInt8:
+            value = *src;
+            break;
+        case DecoderSettings::Int16:
+            value = readField<qint16>(src, littleEndian);
+            break;
+        case DecoderSettings::UInt16:
+            value = readField<quint16>(src, littleEndian);
+            break;
+        case DecoderSettings::Int32:
+            value = readField<qint32>(src, littleEndian);
+            break;
+        case DecoderSettings::UInt32:
+            value = readField<quint32>(src, littleEndian);
+            break;
+        case DecoderSettings::Float32:
+        {
+            const quint32 bits = readField<quint32>(src, littleEndian);
+            float f;
+            std::memcpy(&f, &bits, sizeof(f));
+            value = f;
+            break;
+        }
+        case DecoderSettings::Float64:
+        {
+            const quint64 bits = readField<quint64>(src, littleEndian);
+            std::memcpy(&value, &bits, sizeof(value));
+            break;
+        }
+        }
+        batch.values.push_back(value);
+        src += DecoderSettings::fieldSize(fields[i]);
+    }
+    return true;
+}
+
+
+// Constructor of the BinaryStructDecoder class
+BinaryStructDecoder::BinaryStructDecoder(const DecoderSettings &settings)
+    : layout(settings)
+    , syncBytes(settings.syncBytes)
+    , frameSize(std::size_t(settings.syncBytes.size() + layout.frameSize()))
+{
+    pending.reserve(2 * frameSize);
+}
+
+void BinaryStructDecoder::reset()
+{
+    pending.clear();
+}
+
+// Frames are decoded in place from the chunk. Only a frame straddling two chunks is copied:
+// the carried bytes are joined with the first frameSize - 1 bytes of the new chunk, which is
+// enough to decide on every frame starting within the carried bytes.
+void BinaryStructDecoder::decodeChunk(const char *data, qint64 size, FrameBatch &batch)
+{
+    batch.channels = layout.channelCount();
+    if (batch.channels == 0)
+    {
+        return;
+    }
+    const uchar *bytes = reinterpret_cast<const uchar *>(data);
+    std::size_t offset = 0;
+
+    if (!pending.empty())
+    {
+        const std::size_t carried = pending.size();
+        const std::size_t joined = std::min(std::size_t(size), frameSize - 1);
+        pending.insert(pending.end(), bytes, bytes + joined);
+        const std::size_t pos = scan(pending.data(), pending.size(), 0, carried, -qint64(carried), batch);
+        if (pos < carried)
+        {
+            // The chunk was too short to complete the carried frame: everything stays pending
+            pending.erase(pending.begin(), pending.begin() + std::ptrdiff_t(pos));
+            return;
+        }
+        offset = pos - carried;
+        pending.clear();
+    }
+
+    const std::size_t pos = scan(bytes, std::size_t(size), offset, std::size_t(size), 0, batch);
+    if (pos < std::size_t(size))
+    {
+        pending.assign(bytes + pos, bytes + size);
+    }
+}
+
+// Private method that decodes the frames starting at positions [pos, limit) of bytes.
+// shift converts positions in bytes to positions in the chunk being decoded.
+// Returns the position of the first frame that couldn't be completed (or limit)
+std::size_t BinaryStructDecoder::scan(const uchar *bytes, std::size_t size, std::size_t pos, std::size_t limit, qint64 shift, FrameBatch &batch) const
+{
+    while (pos < limit)
+    {
+        if (!syncBytes.isEmpty())
+        {
+            // jump to the next candidate sync byte
+            const void *found = std::memchr(bytes + pos, uchar(syncBytes[0]), limit - pos);
+            if (found == nullptr)
+            {
+                return limit;
+            }
+            pos = std::size_t(static_cast<const uchar *>(found) - bytes);
+        }
+        if (pos + frameSize > size)
+        {
+            return pos;
+        }
+        if (matches(bytes + pos) && layout.decode(bytes + pos + syncBytes.size(), batch))
+        {
+            pos += frameSize;
+            batch.markEnd(qint64(pos) + shift);
+        } else
+        {
+            ++pos;
+        }
+    }
+    return pos;
+}
+
+bool BinaryStructDecoder::matches(const uchar *frame) const
+{
+    return std::memcmp(frame, syncBytes.constData(), std::size_t(syncBytes.size())) == 0;
+}
+
+
+// Constructor of the CobsDecoder class
+CobsDecoder::CobsDecoder(const DecoderSettings &settings)
+    : layout(settings)
+{
+    frame.reserve(std::size_t(layout.frameSize()) + 1);
+    reset();
+}
+
+void CobsDecoder::reset()
+{
+    frame.clear();
+    remaining = 0;
+    pendingZero = false;
+    discard = true;
+}
+
+// Each block starts with a code byte c: the next c - 1 bytes are data and, unless c is 0xFF or
+// the block ends the frame, they are followed by an implicit zero
+void CobsDecoder::decodeChunk(const char *data, qint64 size, FrameBatch &batch)
+{
+    batch.channels = layout.channelCount();
+    if (batch.channels == 0)
+    {
+        return;
+    }
+    const std::size_t maxSize = std::size_t(layout.frameSize());
+
+    for (qint64 i = 0; i < size; ++i)
+    {
+        const uchar b = uchar(data[i]);
+        if (b == 0)
+        {
+            if (!discard && remaining == 0 && frame.size() == maxSize && layout.decode(frame.data(), batch))
+            {
+                batch.markEnd(i + 1);
+            }
+            frame.clear();
+            remaining = 0;
+            pendingZero = false;
+            discard = false;
+            continue;
+        }
+        if (discard)
+        {
+            continue;
+        }
+
+        if (remaining == 0)
+        {
+            if (pendingZero)
+            {
+                frame.push_back(0);
+            }
+            remaining = b - 1;
+            pendingZero = (b != 0xFF);
+        } else
+        {
+            frame.push_back(b);
+            --remaining;
+        }
+        if (frame.size() > maxSize)
+        {
+            discard = true;
+        }
+    }
+}
+
+
+// Constructor of the SlipDecoder class
+SlipDecoder::SlipDecoder(const DecoderSettings &settings)
+    : layout(settings)
+{
+    frame.reserve(std::size_t(layout.frameSize()) + 1);
+    reset();
+}
+
+void SlipDecoder::reset()
+{
+    frame.clear();
+    escaped = false;
+    discard = true;
+}
+
+void SlipDecoder::decodeChunk(const char *data, qint64 size, FrameBatch &batch)
+{
+    static const uchar End = 0xC0, Esc = 0xDB, EscEnd = 0xDC, EscEsc = 0xDD;
+
+    batch.channels = layout.channelCount();
+    if (batch.channels == 0)
+    {
+        return;
+    }
+    const std::size_t maxSize = std::size_t(layout.frameSize());
+
+    for (qint64 i = 0; i < size; ++i)
+    {
+        const uchar b = uchar(data[i]);
+        if (b == End)
+        {
+            if (!discard && frame.size() == maxSize && layout.decode(frame.data(), batch))
+            {
+                batch.markEnd(i + 1);
+            }
+            frame.clear();
+            escaped = false;
+            discard = false;
+            continue;
+        }
+        if (discard)
+        {
+            continue;
+        }
+
+        if (escaped)
+        {
+            frame.push_back(b == EscEnd ? End : (b == EscEsc ? Esc : b));
+            escaped = false;
+        } else if (b == Esc)
+        {
+            escaped = true;
+        } else
+        {
+            frame.push_back(b);
+        }
+        if (frame.size() > maxSize)
+        {
+            discard = true;
+        }
+    }
+}
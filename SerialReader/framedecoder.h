@@ -0,0 +1,304 @@
+#ifndef FRAMEDECODER_H
+#define FRAMEDECODER_H
+
+#include <QtGlobal>
+#include <QMetaType>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <vector>
+
+#include "sampleparser.h"
+
+// Settings selecting and configuring the decoder used to turn serial bytes into frames
+//
+// A frame is the set of values (one per channel) transmitted together by the device.
+// Binary layouts describe the payload of a frame as a list of fields, one field per channel,
+// optionally followed by a checksum computed over those fields.
+struct DecoderSettings
+{
+    enum Type { CsvStream       // doubles separated by commas, one value per frame
+              , CsvLines        // one frame per line, columns separated by commas
+              , BinaryStruct    // fixed-size binary frames, located with sync bytes and/or checksum
+              , Cobs            // binary frames with COBS encoding, terminated by a zero byte
+              , Slip            // binary frames with SLIP encoding (RFC 1055)
+              };
+
+    enum TimeSource { ArrivalTime       // when the bytes of the frame were read from the port
+                    , InterpolatedTime  // arrival time, corrected with the baud rate for the frame's position in the read
+                    , DeviceTime        // timestamp transmitted by the device in one of the channels
+                    };
+
+    enum FieldType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+    enum Checksum { NoChecksum
+                  , Crc8        // polynomial 0x07, initial value 0x00
+                  , Crc16       // CRC-16/CCITT-FALSE: polynomial 0x1021, initial value 0xFFFF
+                  , Crc32       // CRC-32 as used by zlib/ethernet
+                  };
+
+    DecoderSettings();
+
+    Type type;
+
+    // CsvLines: number of columns per line, 0 takes it from the first complete line
+    int channels;
+
+    // Binary types: layout of the payload
+    QVector<FieldType> fields;
+
+    bool littleEndian;
+
+    // BinaryStruct: bytes that start every frame (may be empty if a checksum is used)
+    QByteArray syncBytes;
+
+    Checksum checksum;
+
+    TimeSource timeSource;
+
+    // DeviceTime: channel holding the timestamp (it is not plotted) and its unit in seconds
+    int timestampChannel;
+
+    double timestampScale;
+
+    // Chain of processing stages applied to the decoded frames before they are plotted and
+    // recorded (see SignalProcessor), empty for none
+    QString processing;
+
+    // Size in bytes of the fields of a binary frame
+    int payloadSize() const;
+
+    static int fieldSize(FieldType type);
+
+    static int checksumSize(Checksum checksum);
+
+    // Parses a layout written as comma separated field names (i8, u8, i16, u16, i32, u32, f32, f64)
+    static bool parseLayout(const QString &text, QVector<FieldType> &fields);
+
+    // Parses sync bytes written in hexadecimal, spaces being ignored (e.g. "AA 55")
+    static bool parseSyncBytes(const QString &text, QByteArray &bytes);
+
+    // Returns false, with the reason in error, if frames can't be decoded with these settings.
+    // Shared by the ui and the command line, so both accept the same settings
+    bool validate(QString &error) const;
+
+    static QStringList typeNames();
+};
+
+Q_DECLARE_METATYPE(DecoderSettings)
+
+// Frames decoded from one or more chunks of bytes, stored row by row (channels values per frame)
+//
+// For every frame, the batch also records the number of bytes fed to the decoder (since the batch
+// was cleared) up to and including the last byte of the frame, which tells when it was received
+struct FrameBatch
+{
+    FrameBatch() : channels(0), consumed(0) {}
+
+    int frameCount() const { return int(ends.size()); }
+
+    const double *frame(int index) const { return values.data() + std::size_t(index) * channels; }
+
+    // Byte count at the end of frame index
+    qint64 frameEnd(int index) const { return ends[std::size_t(index)]; }
+
+    // To be called by decoders once the values of a frame have been appended. offset is the
+    // index, in the chunk being decoded, of the byte following the last byte of the frame
+    void markEnd(qint64 offset) { ends.push_back(consumed + offset); }
+
+    void clear() { values.clear(); ends.clear(); consumed = 0; }
+
+    int channels;
+
+    std::vector<double> values;
+
+    std::vector<qint64> ends;
+
+    // Bytes fed to the decoder before the chunk being decoded
+    qint64 consumed;
+};
+
+// Interface of all frame decoders
+//
+// A decoder is fed the bytes read from the serial port, chunk after chunk, and appends every
+// frame it completes to a FrameBatch. Partial frames are kept internally until the next chunk.
+// After reset() the decoder discards data until the next frame boundary, since the first frame
+// after opening a port is usually truncated.
+class FrameDecoder
+{
+public:
+    virtual ~FrameDecoder() {}
+
+    virtual void reset() = 0;
+
+    void decode(const char *data, qint64 size, FrameBatch &batch)
+    {
+        decodeChunk(data, size, batch);
+        batch.consumed += size;
+    }
+
+    // Creates the decoder described by settings. The caller takes ownership
+    static FrameDecoder *create(const DecoderSettings &settings);
+
+protected:
+    virtual void decodeChunk(const char *data, qint64 size, FrameBatch &batch) = 0;
+};
+
+// Doubles separated by commas, each of them being a frame with a single channel
+class CsvStreamDecoder : public FrameDecoder
+{
+public:
+    CsvStreamDecoder();
+
+    void reset() override;
+
+protected:
+    void decodeChunk(const char *data, qint64 size, FrameBatch &batch) override;
+
+private:
+    struct Sink
+    {
+        void value(double v, qint64 position);
+        void endOfLine(qint64) {}
+
+        CsvStreamDecoder *decoder;
+        FrameBatch *batch;
+    };
+
+    SampleParser parser;
+
+    bool skipNext;
+};
+
+// Lines of comma separated doubles, each line being a frame with one channel per column
+//
+// Missing or non-numeric columns are stored as NaN, extra columns are ignored
+class CsvLinesDecoder : public FrameDecoder
+{
+public:
+    explicit CsvLinesDecoder(int channels);
+
+    void reset() override;
+
+protected:
+    void decodeChunk(const char *data, qint64 size, FrameBatch &batch) override;
+
+private:
+    struct Sink
+    {
+        void value(double v, qint64 position);
+        void endOfLine(qint64 position);
+
+        CsvLinesDecoder *decoder;
+        FrameBatch *batch;
+    };
+
+    SampleParser parser;
+
+    int configuredChannels;
+
+    int channels;
+
+    std::vector<double> row;
+
+    bool skipLine;
+};
+
+// Converts binary payloads to frames according to a field layout, verifying their checksum
+class BinaryLayout
+{
+public:
+    explicit BinaryLayout(const DecoderSettings &settings);
+
+    int channelCount() const { return fields.size(); }
+
+    // Size of a payload including its checksum
+    int frameSize() const { return payloadSize + checksumSize; }
+
+    // Returns true and appends a frame to batch if payload (frameSize() bytes) has a valid checksum
+    bool decode(const uchar *payload, FrameBatch &batch) const;
+
+private:
+    QVector<DecoderSettings::FieldType> fields;
+
+    bool littleEndian;
+
+    DecoderSettings::Checksum checksum;
+
+    int payloadSize;
+
+    int checksumSize;
+};
+
+// Fixed-size binary frames: [sync bytes][payload][checksum]
+class BinaryStructDecoder : public FrameDecoder
+{
+public:
+    explicit BinaryStructDecoder(const DecoderSettings &settings);
+
+    void reset() override;
+
+protected:
+    void decodeChunk(const char *data, qint64 size, FrameBatch &batch) override;
+
+private:
+    std::size_t scan(const uchar *bytes, std::size_t size, std::size_t pos, std::size_t limit, qint64 shift, FrameBatch &batch) const;
+
+    bool matches(const uchar *frame) const;
+
+    BinaryLayout layout;
+
+    QByteArray syncBytes;
+
+    std::size_t frameSize;
+
+    // Bytes of a frame that started in a previous chunk
+    std::vector<uchar> pending;
+};
+
+// Binary frames encoded with Consistent Overhead Byte Stuffing, delimited by zero bytes
+class CobsDecoder : public FrameDecoder
+{
+public:
+    explicit CobsDecoder(const DecoderSettings &settings);
+
+    void reset() override;
+
+protected:
+    void decodeChunk(const char *data, qint64 size, FrameBatch &batch) override;
+
+private:
+    BinaryLayout layout;
+
+    std::vector<uchar> frame;
+
+    int remaining;
+
+    bool pendingZero;
+
+    bool discard;
+};
+
+// Binary frames encoded with SLIP, delimited by END (0xC0) bytes
+class SlipDecoder : public FrameDecoder
+{
+public:
+    explicit SlipDecoder(const DecoderSettings &settings);
+
+    void reset() override;
+
+protected:
+    void decodeChunk(const char *data, qint64 size, FrameBatch &batch) override;
+
+private:
+    BinaryLayout layout;
+
+    std::vector<uchar> frame;
+
+    bool escaped;
+
+    bool discard;
+};
+
+#endif // FRAMEDECODER_H
@@ -0,0 +1,459 @@
+// Definition of methods for the HeadlessCapture class
+
+#include "headlesscapture.h"
+#include "qcustomplot.h"
+#include "signalprocessor.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QSaveFile>
+#include <csignal>
+#include <cstdio>
+#include <limits>
+
+namespace {
+
+// Set by the signal handler, polled by HeadlessCapture::drain()
+volatile std::sig_atomic_t interrupted = 0;
+
+void onInterrupt(int)
+{
+    interrupted = 1;
+}
+
+// Names of the decoders, time sources and checksums on the command line, in the order of their enums
+const QStringList decoderNames = {"csv-stream", "csv-lines", "binary", "cobs", "slip"};
+const QStringList timeSourceNames = {"arrival", "interpolated", "device"};
+const QStringList checksumNames = {"none", "crc8", "crc16", "crc32"};
+const QStringList unitNames = {"s", "ms", "us", "ns"};
+
+// Returns the index of value in names, or -1 (and a message in error) if it isn't there
+int lookup(const QStringList &names, const QString &value, const char *option, QString &error)
+{
+    const int index = names.indexOf(value.toLower());
+    if (index < 0)
+    {
+        error = QString("Invalid --%1 '%2' (expected %3)").arg(option, value, names.join(", "));
+    }
+    return index;
+}
+
+bool toNumber(const QString &value, double minimum, double &number, const char *option, QString &error)
+{
+    bool ok = false;
+    number = value.toDouble(&ok);
+    if (!ok || number < minimum)
+    {
+        error = QString("Invalid --%1 '%2'").arg(option, value);
+        return false;
+    }
+    return true;
+}
+
+// Reads the options of the acquisition from the command line, with the same checks as the ui.
+// Returns false (and a message in error) if any of them is not valid
+bool parseOptions(const QCommandLineParser &parser, HeadlessCapture::Options &options, QString &error)
+{
+    options.portNames = AcquisitionSession::splitPortNames(parser.values("port").join(';'));
+    if (options.portNames.isEmpty())
+    {
+        error = "No port given (--port)";
+        return false;
+    }
+
+    double number;
+    if (!toNumber(parser.value("baud"), 0, number, "baud", error))
+    {
+        return false;
+    }
+    options.baudRate = qint32(number);
+
+    DecoderSettings &settings = options.settings;
+    int index = lookup(decoderNames, parser.value("decoder"), "decoder", error);
+    if (index < 0)
+    {
+        return false;
+    }
+    settings.type = DecoderSettings::Type(index);
+
+    if (!toNumber(parser.value("channels"), 0, number, "channels", error))
+    {
+        return false;
+    }
+    settings.channels = int(number);
+
+    if ((index = lookup(checksumNames, parser.value("checksum"), "checksum", error)) < 0)
+    {
+        return false;
+    }
+    settings.checksum = DecoderSettings::Checksum(index);
+    settings.littleEndian = !parser.isSet("big-endian");
+
+    if ((index = lookup(timeSourceNames, parser.value("timestamps"), "timestamps", error)) < 0)
+    {
+        return false;
+    }
+    settings.timeSource = DecoderSettings::TimeSource(index);
+    if (!toNumber(parser.value("timestamp-channel"), 1, number, "timestamp-channel", error))
+    {
+        return false;
+    }
+    settings.timestampChannel = int(number) - 1;
+    if ((index = lookup(unitNames, parser.value("timestamp-unit"), "timestamp-unit", error)) < 0)
+    {
+        return false;
+    }
+    static const double units[] = {1.0, 1e-3, 1e-6, 1e-9};
+    settings.timestampScale = units[index];
+
+    if (settings.type >= DecoderSettings::BinaryStruct)
+    {
+        if (!DecoderSettings::parseLayout(parser.value("layout"), settings.fields))
+        {
+            error = QString("Invalid --layout '%1'").arg(parser.value("layout"));
+            return false;
+        }
+    }
+    if (settings.type == DecoderSettings::BinaryStruct
+        && !DecoderSettings::parseSyncBytes(parser.value("sync"), settings.syncBytes))
+    {
+        error = QString("Invalid --sync '%1'").arg(parser.value("sync"));
+        return false;
+    }
+    if (!settings.validate(error))
+    {
+        return false;
+    }
+
+    settings.processing = parser.value("process");
+    if (!SignalProcessor().setChain(settings.processing, error))
+    {
+        return false;
+    }
+
+    options.output = parser.value("output");
+    options.snapshot = parser.value("snapshot");
+    if (!toNumber(parser.value("duration"), 0, options.duration, "duration", error)
+            || !toNumber(parser.value("snapshot-interval"), 0.1, options.snapshotInterval, "snapshot-interval", error)
+            || !toNumber(parser.value("snapshot-window"), 0, options.snapshotWindow, "snapshot-window", error)
+            || !toNumber(parser.value("stats-interval"), 0, options.statsInterval, "stats-interval", error))
+    {
+        return false;
+    }
+
+    const QStringList size = parser.value("snapshot-size").toLower().split('x');
+    options.snapshotSize = size.size() == 2 ? QSize(size[0].toInt(), size[1].toInt()) : QSize();
+    if (options.snapshotSize.width() <= 0 || options.snapshotSize.height() <= 0)
+    {
+        error = QString("Invalid --snapshot-size '%1' (expected WIDTHxHEIGHT)").arg(parser.value("snapshot-size"));
+        return false;
+    }
+    return true;
+}
+
+}
+
+
+// Constructor of the Options struct, with the defaults of the command line
+HeadlessCapture::Options::Options()
+    : baudRate(9600)
+    , duration(0)
+    , snapshotInterval(10)
+    , snapshotWindow(10)
+    , snapshotSize(1280, 720)
+    , statsInterval(10)
+{
+}
+
+// Constructor of the HeadlessCapture class
+//
+// As in the MainWindow, the ports are read by the acquisition session in its own threads.
+// The offscreen plot is only created if snapshots are requested
+HeadlessCapture::HeadlessCapture(const Options &options, QObject *parent)
+    : QObject(parent)
+    , options(options)
+    , lastStatus(0)
+    , samples(0)
+    , running(false)
+    , stopping(false)
+    , plot(nullptr)
+    , t0(0)
+    , t0_set(false)
+{
+    QObject::connect(&session, &AcquisitionSession::started, this, &HeadlessCapture::onReaderStarted);
+    QObject::connect(&session, &AcquisitionSession::errorOccurred, this, &HeadlessCapture::onError);
+    QObject::connect(&session, &AcquisitionSession::recordingError, this, &HeadlessCapture::onError);
+
+    // Draining the rings a few times per second is enough without a window to update
+    drainTimer.setTimerType(Qt::CoarseTimer);
+    QObject::connect(&drainTimer, &QTimer::timeout, this, &HeadlessCapture::drain);
+    QObject::connect(&snapshotTimer, &QTimer::timeout, this, &HeadlessCapture::saveSnapshot);
+
+    if (!options.snapshot.isEmpty())
+    {
+        plot = new QCustomPlot();
+        plot->resize(options.snapshotSize);
+        plot->xAxis->setLabel("Time (s)");
+        plot->yAxis->setLabel("Signal");
+    }
+}
+
+// Destructor of the HeadlessCapture class
+HeadlessCapture::~HeadlessCapture()
+{
+    session.stop();
+    delete plot;
+}
+
+bool HeadlessCapture::requested(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (qstrcmp(argv[i], "--headless") == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int HeadlessCapture::exec(int argc, char *argv[])
+{
+    // Snapshots are rendered by QCustomPlot, a widget, which needs a QApplication. The offscreen
+    // platform lets it run without a display. Otherwise no gui is loaded at all
+    bool snapshots = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        snapshots = snapshots || qstrcmp(argv[i], "--snapshot") == 0 || qstrncmp(argv[i], "--snapshot=", 11) == 0;
+    }
+    QScopedPointer<QCoreApplication> app;
+    if (snapshots)
+    {
+        if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+        app.reset(new QApplication(argc, argv));
+    } else
+    {
+        app.reset(new QCoreApplication(argc, argv));
+    }
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Serial Port Reader, headless mode: acquires (and records) data from a serial port without any window.");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"headless", "Run without any window (required)."},
+        {{"p", "port"}, "Serial port, or simulated port (sim:..., replay:FILE). Repeat it (or separate names with ';') to read several ports.", "name"},
+        {{"b", "baud"}, "Baud rate (default 9600).", "rate", "9600"},
+        {{"d", "decoder"}, "Decoder: " + decoderNames.join(", ") + " (default csv-stream).", "type", "csv-stream"},
+        {"channels", "csv-lines: number of columns, 0 takes it from the first line (default 0).", "n", "0"},
+        {"layout", "Binary decoders: frame layout, e.g. i16,i16,f32.", "fields"},
+        {"sync", "binary: sync bytes in hex, e.g. AA55.", "hex"},
+        {"checksum", "Binary decoders: " + checksumNames.join(", ") + " (default none).", "type", "none"},
+        {"big-endian", "Binary decoders: values are big endian."},
+        {"timestamps", "Time source: " + timeSourceNames.join(", ") + " (default interpolated).", "source", "interpolated"},
+        {"timestamp-channel", "device timestamps: channel holding them (default 1).", "n", "1"},
+        {"timestamp-unit", "device timestamps: " + unitNames.join(", ") + " (default s).", "unit", "s"},
+        {"process", "Processing chain applied to the frames, e.g. \"lowpass:0.05; decimate:4\" (see the README).", "chain"},
+        {{"o", "output"}, "Record every sample to this capture file (.srcap).", "file"},
+        {{"t", "duration"}, "Seconds to acquire for, 0 until interrupted (default 0).", "seconds", "0"},
+        {"snapshot", "Save a PNG snapshot of the plot to this file periodically.", "file"},
+        {"snapshot-interval", "Seconds between snapshots (default 10).", "seconds", "10"},
+        {"snapshot-window", "Seconds of data shown in the snapshots (default 10).", "seconds", "10"},
+        {"snapshot-size", "Size of the snapshots (default 1280x720).", "WxH", "1280x720"},
+        {"stats-interval", "Seconds between status lines, 0 for a summary at the end only (default 10).", "seconds", "10"}
+    });
+    parser.process(*app);
+
+    Options options;
+    QString error;
+    if (!parseOptions(parser, options, error))
+    {
+        std::fprintf(stderr, "%s\n", qPrintable(error));
+        return 2;
+    }
+
+    qRegisterMetaType<DecoderSettings>("DecoderSettings");
+    HeadlessCapture capture(options);
+    QTimer::singleShot(0, &capture, &HeadlessCapture::start);
+    return app->exec();
+}
+
+// Slot that starts the acquisition. Ctrl+C (or SIGTERM) stops it cleanly, closing the capture file
+void HeadlessCapture::start()
+{
+    std::signal(SIGINT, onInterrupt);
+    std::signal(SIGTERM, onInterrupt);
+    elapsed.start();
+    drainTimer.start(100);
+    pending.resize(options.portNames.size());
+    graphs.resize(options.portNames.size());
+    session.start(options.portNames, options.baudRate, options.settings);
+}
+
+// Private method (slot) called once all ports are open: recording starts now
+void HeadlessCapture::onReaderStarted()
+{
+    running = true;
+    elapsed.restart();
+    std::fprintf(stderr, "Reading %s at %d baud\n", qPrintable(options.portNames.join(", ")), options.baudRate);
+    if (!options.output.isEmpty())
+    {
+        session.startRecording(options.output);
+    }
+    if (plot != nullptr)
+    {
+        snapshotTimer.start(int(options.snapshotInterval * 1000));
+    }
+}
+
+// Private method (slot) called when a port can't be opened or a capture file can't be written
+void HeadlessCapture::onError(const QString &message)
+{
+    std::fprintf(stderr, "Error: %s\n", qPrintable(message));
+    stop(1);
+}
+
+void HeadlessCapture::stop(int exitCode)
+{
+    if (stopping)
+    {
+        return;
+    }
+    stopping = true;
+    drainTimer.stop();
+    snapshotTimer.stop();
+
+    // The capture files are complete once the ports are closed
+    session.stop();
+    drain();
+    if (plot != nullptr && running)
+    {
+        saveSnapshot();
+    }
+    if (running)
+    {
+        printStatus();
+    }
+    QCoreApplication::exit(exitCode);
+}
+
+// Private method (slot) called periodically by drainTimer
+//
+// It pops the samples the readers have acquired (adding them to the snapshot plot, if any),
+// prints the status and ends the acquisition after the requested duration or an interrupt
+void HeadlessCapture::drain()
+{
+    for (int port = 0; port < session.portCount(); ++port)
+    {
+        samples += session.ring(port).popAll([this, port](const Sample &sample) {
+            if (plot != nullptr)
+            {
+                const double x = sample.time * 1e-9;
+                if (!t0_set)
+                {
+                    t0 = x;
+                    t0_set = true;
+                }
+                pending[port].append(x - t0, sample.values, sample.channels);
+            }
+        });
+    }
+    if (plot != nullptr)
+    {
+        plotPending();
+    }
+
+    if (stopping)
+    {
+        return;
+    }
+    if (interrupted || (running && options.duration > 0 && elapsed.elapsed() >= options.duration * 1000))
+    {
+        stop(0);
+        return;
+    }
+    if (running && options.statsInterval > 0 && elapsed.elapsed() - lastStatus >= options.statsInterval * 1000)
+    {
+        lastStatus = elapsed.elapsed();
+        printStatus();
+    }
+}
+
+// Private method that appends the samples in pending to the graphs of the snapshot plot,
+// discarding the data older than the snapshot window so memory use stays constant
+void HeadlessCapture::plotPending()
+{
+    double latest = -std::numeric_limits<double>::infinity();
+    bool added = false;
+    for (int port = 0; port < pending.size(); ++port)
+    {
+        const ChannelBuffer &buffer = pending[port];
+        if (buffer.isEmpty())
+        {
+            continue;
+        }
+        while (graphs[port].size() < buffer.channelCount())
+        {
+            graphs[port].append(plot->addGraph());
+            added = true;
+        }
+        for (int i = 0; i < buffer.channelCount(); ++i)
+        {
+            graphs[port][i]->addData(buffer.keys(), buffer.column(i), true);
+        }
+        latest = qMax(latest, buffer.keys().last());
+        pending[port].clear();
+    }
+    if (latest == -std::numeric_limits<double>::infinity())
+    {
+        return;
+    }
+
+    const int count = plot->graphCount();
+    int index = 0;
+    for (int port = 0; port < graphs.size(); ++port)
+    {
+        for (int i = 0; i < graphs[port].size(); ++i, ++index)
+        {
+            QCPGraph *graph = graphs[port][i];
+            graph->data()->removeBefore(latest - options.snapshotWindow);
+            if (added)
+            {
+                graph->setName(graphs.size() > 1 ? QString("%1 channel %2").arg(options.portNames[port]).arg(i + 1)
+                                                 : QString("Channel %1").arg(i + 1));
+                graph->setPen(QPen(count > 1 ? QColor::fromHsv((index * 360 / count) % 360, 220, 200) : QColor(Qt::blue)));
+            }
+        }
+    }
+    plot->legend->setVisible(count > 1);
+}
+
+// Private method (slot) that renders the plot offscreen and replaces the snapshot file with it
+//
+// The image is written to a temporary file first, so readers of the snapshot never see a partial one
+void HeadlessCapture::saveSnapshot()
+{
+    plot->rescaleAxes();
+    QSaveFile file(options.snapshot);
+    if (!file.open(QIODevice::WriteOnly)
+            || !plot->toPixmap(options.snapshotSize.width(), options.snapshotSize.height()).save(&file, "PNG")
+            || !file.commit())
+    {
+        std::fprintf(stderr, "Snapshot not saved: %s\n", qPrintable(file.errorString()));
+    }
+}
+
+// Private method that prints the number of samples acquired and lost so far to stderr, and the
+// bytes simulated ports discarded
+void HeadlessCapture::printStatus()
+{
+    const double seconds = elapsed.elapsed() * 1e-3;
+    std::fprintf(stderr, "%.1f s: %llu samples (%.1f/s), %llu dropped, %llu bytes overrun\n",
+                 seconds,
+                 static_cast<unsigned long long>(samples),
+                 seconds > 0 ? samples / seconds : 0.0,
+                 static_cast<unsigned long long>(session.droppedSamples()),
+                 static_cast<unsigned long long>(session.overrunBytes()));
+}
@@ -0,0 +1,121 @@
+#ifndef HEADLESSCAPTURE_H
+#define HEADLESSCAPTURE_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "acquisitionsession.h"
+#include "channelbuffer.h"
+
+class QCPGraph;
+class QCustomPlot;
+
+// Definition of the class that runs an acquisition from the command line, without any window
+//
+// The serial ports are read by an AcquisitionSession, exactly as in the GUI, and every sample
+// can be recorded to a capture file (one per port). The main thread only drains the ring buffers
+// a few times per second and prints statistics, so a single process can log many devices at a
+// small CPU cost. Optionally, the most recent data is plotted in an offscreen
+// QCustomPlot and saved as a PNG snapshot at regular intervals; only then is a QApplication needed.
+class HeadlessCapture : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options
+    {
+        Options();
+
+        QStringList portNames;
+
+        qint32 baudRate;
+
+        DecoderSettings settings;
+
+        // Capture file to record to (none if empty), see AcquisitionSession::recordingFileName()
+        QString output;
+
+        // Seconds to acquire for, 0 to acquire until interrupted (Ctrl+C)
+        double duration;
+
+        // PNG file overwritten with a snapshot of the plot every snapshotInterval seconds (none if empty)
+        QString snapshot;
+
+        double snapshotInterval;
+
+        // Seconds of data shown in the snapshots
+        double snapshotWindow;
+
+        QSize snapshotSize;
+
+        // Seconds between status lines printed to stderr, 0 to print only a summary at the end
+        double statsInterval;
+    };
+
+    explicit HeadlessCapture(const Options &options, QObject *parent = nullptr);
+    ~HeadlessCapture();
+
+    // Returns true if the command line asks for the headless mode (--headless)
+    static bool requested(int argc, char *argv[]);
+
+    // Parses the command line, runs the acquisition and returns the exit code of the application
+    static int exec(int argc, char *argv[]);
+
+public slots:
+    void start();
+
+    // Stops the acquisition (closing the capture file) and quits the application with exitCode
+    void stop(int exitCode = 0);
+
+private slots:
+    void onReaderStarted();
+
+    void onError(const QString &message);
+
+    void drain();
+
+    void saveSnapshot();
+
+private:
+    void printStatus();
+
+    void plotPending();
+
+    Options options;
+
+    AcquisitionSession session;
+
+    QTimer drainTimer;
+
+    QTimer snapshotTimer;
+
+    QElapsedTimer elapsed;
+
+    qint64 lastStatus;
+
+    quint64 samples;
+
+    // The ports have been opened / stop() has been called
+    bool running;
+
+    bool stopping;
+
+    // Offscreen plot of the snapshots (only with a snapshot file), and the graphs and the samples
+    // not plotted yet of every port
+    QCustomPlot *plot;
+
+    QVector<QVector<QCPGraph *> > graphs;
+
+    QVector<ChannelBuffer> pending;
+
+    double t0;
+
+    bool t0_set;
+};
+
+#endif // HEADLESSCAPTURE_H
@@ -0,0 +1,197 @@
+// Definition of methods for the LatencyHistogram and LatencyStats classes
+
+#include "latencystats.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStringList>
+#include <limits>
+
+
+namespace {
+
+// Duration in ns as text, in the most readable unit
+QString formatDuration(qint64 ns)
+{
+    if (ns < 1000)
+    {
+        return QString("%1 ns").arg(ns);
+    } else if (ns < 1000000)
+    {
+        return QString("%1 us").arg(ns / 1e3, 0, 'f', 1);
+    } else if (ns < Q_INT64_C(1000000000))
+    {
+        return QString("%1 ms").arg(ns / 1e6, 0, 'f', 1);
+    }
+    return QString("%1 s").arg(ns / 1e9, 0, 'f', 2);
+}
+
+}
+
+// Constructor of the LatencyHistogram class
+LatencyHistogram::LatencyHistogram()
+    : counts((MaxMagnitude - SubBucketBits + 2) << SubBucketBits, 0)
+    , total(0)
+    , lowest(std::numeric_limits<qint64>::max())
+    , highest(0)
+    , sum(0)
+{
+}
+
+// Private method that returns the bucket of value. Values below 2^SubBucketBits have a bucket
+// each; above, the bits following the most significant one select the bucket within its power of two
+int LatencyHistogram::bucketOf(qint64 value)
+{
+    if (value < (1 << SubBucketBits))
+    {
+        return int(qMax(value, Q_INT64_C(0)));
+    }
+    int magnitude = 63;
+    while (!(value >> magnitude))
+    {
+        --magnitude;
+    }
+    if (magnitude > MaxMagnitude)
+    {
+        return ((MaxMagnitude - SubBucketBits + 2) << SubBucketBits) - 1;
+    }
+    const int shift = magnitude - SubBucketBits;
+    const int subBucket = int(value >> shift) & ((1 << SubBucketBits) - 1);
+    return ((shift + 1) << SubBucketBits) + subBucket;
+}
+
+// Private method that returns the highest value counted in bucket
+qint64 LatencyHistogram::bucketEnd(int bucket)
+{
+    const int group = bucket >> SubBucketBits;
+    if (group == 0)
+    {
+        return bucket;
+    }
+    const int shift = group - 1;
+    const qint64 subBucket = bucket & ((1 << SubBucketBits) - 1);
+    return ((Q_INT64_C(1) << (shift + SubBucketBits)) | (subBucket << shift)) + (Q_INT64_C(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(qint64 value, quint64 count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    value = qMax(value, Q_INT64_C(0));
+    counts[bucketOf(value)] += count;
+    total += count;
+    lowest = qMin(lowest, value);
+    highest = qMax(highest, value);
+    sum += double(value) * count;
+}
+
+void LatencyHistogram::clear()
+{
+    counts.fill(0);
+    total = 0;
+    lowest = std::numeric_limits<qint64>::max();
+    highest = 0;
+    sum = 0;
+}
+
+qint64 LatencyHistogram::percentile(double percentile) const
+{
+    if (total == 0)
+    {
+        return 0;
+    }
+    const quint64 rank = qMax(Q_UINT64_C(1), quint64(qBound(0.0, percentile, 100.0) / 100 * total + 0.5));
+    quint64 seen = 0;
+    for (int i = 0; i < counts.size(); ++i)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+        {
+            return qMin(bucketEnd(i), highest);
+        }
+    }
+    return highest;
+}
+
+// Public method that writes, for each non-empty bucket, its highest value (ns), the percentage of
+// values up to it and the number of values in it
+void LatencyHistogram::write(QTextStream &out) const
+{
+    out << "value_ns\tpercentile\tcount\n";
+    quint64 seen = 0;
+    for (int i = 0; i < counts.size(); ++i)
+    {
+        if (counts[i] == 0)
+        {
+            continue;
+        }
+        seen += counts[i];
+        out << qMin(bucketEnd(i), highest) << '\t' << QString::number(100.0 * seen / total, 'f', 4) << '\t' << counts[i] << '\n';
+    }
+}
+
+qint64 LatencyStats::now()
+{
+    static QElapsedTimer clock;
+    static bool started = (clock.start(), true);
+    Q_UNUSED(started);
+    return clock.nsecsElapsed();
+}
+
+QString LatencyStats::stageName(Stage stage)
+{
+    static const char *names[StageCount] = {"Read -> decoded", "Decoded -> plotted", "Plotted -> shown", "Read -> shown", "Replot"};
+    return names[stage];
+}
+
+void LatencyStats::clear()
+{
+    for (int s = 0; s < StageCount; ++s)
+    {
+        histograms[s].clear();
+    }
+}
+
+QString LatencyStats::summary() const
+{
+    QStringList lines;
+    lines << QString("%1%2%3%4").arg("", -20).arg("p50", 10).arg("p99", 10).arg("max", 10);
+    for (int s = 0; s < StageCount; ++s)
+    {
+        const LatencyHistogram &h = histograms[s];
+        lines << QString("%1%2%3%4").arg(stageName(Stage(s)), -20)
+                                    .arg(formatDuration(h.percentile(50)), 10)
+                                    .arg(formatDuration(h.percentile(99)), 10)
+                                    .arg(formatDuration(h.maximum()), 10);
+    }
+    return lines.join('\n');
+}
+
+bool LatencyStats::save(const QString &fileName, QString &error) const
+{
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Text))
+    {
+        error = file.errorString();
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << summary() << "\n";
+    for (int s = 0; s < StageCount; ++s)
+    {
+        const LatencyHistogram &h = histograms[s];
+        out << "\n# " << stageName(Stage(s)) << ": " << h.count() << " values, min " << h.minimum()
+            << " ns, mean " << qint64(h.mean()) << " ns, max " << h.maximum() << " ns\n";
+        h.write(out);
+    }
+    out.flush();
+    if (file.error() != QFile::NoError)
+    {
+        error = file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,98 @@
+#ifndef LATENCYSTATS_H
+#define LATENCYSTATS_H
+
+#include <QString>
+#include <QTextStream>
+#include <QVector>
+
+// Definition of the class that counts latencies (in ns) in a log-linear histogram
+//
+// As in HdrHistogram, every power of two is split into 2^SubBucketBits buckets, so any value is
+// counted with a relative error below 1%, recording costs a few instructions and the histogram
+// has a fixed size (values above 2^MaxMagnitude ns, about 4.9 hours, are counted in the last
+// bucket). Minimum, maximum and mean are exact.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    static const int SubBucketBits = 7;
+
+    static const int MaxMagnitude = 44;
+
+    void record(qint64 value, quint64 count = 1);
+
+    void clear();
+
+    quint64 count() const { return total; }
+
+    qint64 minimum() const { return total > 0 ? lowest : 0; }
+
+    qint64 maximum() const { return highest; }
+
+    double mean() const { return total > 0 ? sum / total : 0; }
+
+    // Value below which percentile % of the recorded values fall (the upper bound of its bucket)
+    qint64 percentile(double percentile) const;
+
+    // Writes the percentile distribution, one line per non-empty bucket
+    void write(QTextStream &out) const;
+
+private:
+    static int bucketOf(qint64 value);
+
+    static qint64 bucketEnd(int bucket);
+
+    QVector<quint64> counts;
+
+    quint64 total;
+
+    qint64 lowest;
+
+    qint64 highest;
+
+    double sum;
+};
+
+// Definition of the class that gathers the latencies of the acquisition pipeline
+//
+// Every sample is stamped (with now()) when the serial port signals that its bytes arrived and
+// when they have been decoded, in the reader thread, then when it is appended to the graphs and
+// when the replot showing it completes, in the GUI thread. The time between consecutive stamps
+// is recorded in the histogram of each stage, and the whole delay in EndToEnd.
+class LatencyStats
+{
+public:
+    enum Stage
+    {
+        Parse,      // bytes arrived -> sample decoded
+        Queue,      // sample decoded -> appended to the graphs
+        Render,     // appended to the graphs -> replot completed
+        EndToEnd,   // bytes arrived -> replot completed
+        Replot,     // duration of each replot (not per sample)
+        StageCount
+    };
+
+    // Monotonic time in ns, the same in all threads
+    static qint64 now();
+
+    static QString stageName(Stage stage);
+
+    void record(Stage stage, qint64 latency, quint64 count = 1) { histograms[stage].record(latency, count); }
+
+    const LatencyHistogram &histogram(Stage stage) const { return histograms[stage]; }
+
+    void clear();
+
+    // Table with the p50, p99 and maximum latency of every stage
+    QString summary() const;
+
+    // Writes the summary and the distribution of every stage to a text file.
+    // Returns false (with the reason in error) if the file can't be written
+    bool save(const QString &fileName, QString &error) const;
+
+private:
+    LatencyHistogram histograms[StageCount];
+};
+
+#endif // LATENCYSTATS_H
@@ -1,9 +1,16 @@
 #include "mainwindow.h"
+#include "headlesscapture.h"
 
 #include <QApplication>
 
 int main(int argc, char *argv[])
 {
+    // With --headless, data is acquired from the command line without creating any window
+    if (HeadlessCapture::requested(argc, argv))
+    {
+        return HeadlessCapture::exec(argc, argv);
+    }
+
     QApplication a(argc, argv);
     MainWindow w;
     w.setWindowTitle("Serial Port Reader");
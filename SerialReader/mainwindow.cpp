@@ -3,46 +3,104 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 
+#include <limits>
+
 
 // Constructor of the MainWindow class
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
+    , aligning(false)
+    , exportThread(nullptr)
+    , exporter(nullptr)
+    , exportProgress(nullptr)
+    , playback(nullptr)
 {
     ui->setupUi(this);
 
     // Initial set up of the plot widget
     ui->plotWidget->setInteraction(QCP::iRangeDrag, true);
     ui->plotWidget->setInteraction(QCP::iRangeZoom, true);
-    ui->plotWidget->addGraph();
-    ui->plotWidget->graph(0)->setScatterStyle(QCPScatterStyle::ssCircle);
+    // The graphs are drawn in a buffered layer of their own, rasterized in the background: a heavy
+    // replot doesn't block panning and zooming, the previous frame staying on screen meanwhile
+    ui->plotWidget->addLayer("graphs", ui->plotWidget->layer("main"), QCustomPlot::limAbove);
+    ui->plotWidget->layer("graphs")->setMode(QCPLayer::lmBuffered);
+    ui->plotWidget->setCurrentLayer("graphs");
+    ui->plotWidget->setPlottingHint(QCP::phAsyncRasterization);
+    resetPorts(1);
     ui->plotWidget->xAxis->setLabel("Time (s)");
     ui->plotWidget->yAxis->setLabel("Signal");
 
-    // The serial port is instantiated
-    external = new QSerialPort(this);
+    t0 = 0;
+    t0_set = false;
+
+    qRegisterMetaType<DecoderSettings>("DecoderSettings");
 
-    // Initialize the QString serialBuffer, used later on to store read serial data
-    serialBuffer = "";
+    // The serial ports are read by the acquisition session in its own threads.
+    // Each port pushes the samples it decodes into its own ring buffer
+    session = new AcquisitionSession(this);
+    QObject::connect(session, &AcquisitionSession::errorOccurred, this, &MainWindow::onReaderError);
+    QObject::connect(session, &AcquisitionSession::recordingError, this, &MainWindow::onRecordingError);
+
+    // The render scheduler periodically drains the ring buffers from the GUI thread and replots,
+    // at the frame rate selected in spin_fps. Completed replots (once rasterized) are reported back to it
+    scheduler = new RenderScheduler(this);
+    scheduler->setFrameRate(ui->spin_fps->value());
+    QObject::connect(scheduler, &RenderScheduler::frame, this, &MainWindow::drainSamples);
+    QObject::connect(scheduler, &RenderScheduler::statsUpdated, this, &MainWindow::onRenderStats);
+    QObject::connect(ui->plotWidget, &QCustomPlot::afterRasterization, scheduler, &RenderScheduler::frameRendered);
+    QObject::connect(ui->plotWidget, &QCustomPlot::afterRasterization, this, &MainWindow::onPlotRendered);
+    ui->label_latency->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    ui->label_latency->setText(latency.summary());
 
     // Look for available serial ports and populate the Combo Box cbox_ports with them
     foreach (const QSerialPortInfo &serialPortInfo, QSerialPortInfo::availablePorts())
     {
         ui->cbox_ports->addItem(serialPortInfo.portName());
     }
-
-    // Populate the Combo Box cbox_baud with all baud rates allowed in Qt
-    ui->cbox_baud->addItems({"1200", "2400", "4800", "9600", "19200", "38400", "57600", "115200"});
+    // The simulated port synthesizes data without hardware. cbox_ports is editable, to type
+    // simulator options or "replay:" and the file to transmit (see simulatedport.h), or
+    // several ports separated by ';' to read all of them at once
+    ui->cbox_ports->addItem("sim:channels=2,rate=1000");
+    ui->cbox_ports->setEditable(true);
+
+    // Populate the Combo Box cbox_baud with all baud rates allowed in Qt, and the higher
+    // ones supported by most USB serial adapters
+    ui->cbox_baud->addItems({"1200", "2400", "4800", "9600", "19200", "38400", "57600", "115200",
+                             "230400", "460800", "921600", "1000000"});
+
+    // Populate the Combo Boxes cbox_decoder and cbox_checksum with the supported frame formats.
+    // The binary frame settings are only enabled for binary decoders
+    ui->cbox_checksum->addItems({"None", "CRC-8", "CRC-16/CCITT", "CRC-32"});
+    ui->cbox_decoder->addItems(DecoderSettings::typeNames());
+    on_cbox_decoder_currentIndexChanged(ui->cbox_decoder->currentIndex());
+
+    // Populate the Combo Boxes cbox_timestamp and cbox_tsUnit (in the order of DecoderSettings::TimeSource).
+    // Samples are timestamped on arrival, interpolated with the baud rate, by default
+    ui->cbox_tsUnit->addItems({"s", "ms", "us", "ns"});
+    ui->cbox_timestamp->addItems({"Arrival", "Arrival (interpolated)", "Device channel"});
+    ui->cbox_timestamp->setCurrentIndex(DecoderSettings::InterpolatedTime);
+    on_cbox_timestamp_currentIndexChanged(ui->cbox_timestamp->currentIndex());
+
+    // Populate the Combo Box cbox_window with the available plot windows (in the order of WindowMode)
+    ui->cbox_window->addItems({"Unlimited", "Last N seconds", "Last N samples"});
+
+    // Populate the Combo Box cbox_align with the interpolations of StreamAligner (after "Off")
+    ui->cbox_align->addItems({"Off", "Linear", "Cubic"});
+    on_cbox_align_currentIndexChanged(ui->cbox_align->currentIndex());
 }
 
 // Destructor of the MainWindow class
 MainWindow::~MainWindow()
 {
-    // Before closing the ui, it closes the serial port (if it is opened)
-    if (external->isOpen())
+    // Before closing the ui, it cancels the csv export (if any) and closes the serial ports
+    if (exportThread != nullptr)
     {
-        external->close();
+        exporter->cancel();
+        exportThread->quit();
+        exportThread->wait();
     }
+    session->stop();
     delete ui;
 }
 
@@ -55,126 +113,472 @@ void MainWindow::on_btn_getData_clicked()
     {
         // If the button is initially not checked i.e., its label reads "Start",
         // its label will change to "Stop"
-        // the port name will be obtained from that selected in the Combo Box cbox_ports
-        // the serial port is opened
+        // the port names will be obtained from that selected (or typed) in the Combo Box cbox_ports
         // the baud rate will be obtained from that selected in the Combo Box cbox_baud
-        // all other serial port parameters are fixed
-        // Finally, the QSerialPort pointer is connected to the slot readSerial()
-
-        ui->btn_getData->setText("Stop");
-
-        external->setPortName(ui->cbox_ports->currentText());
-
-        external->open(QSerialPort::ReadOnly);
+        // the decoder will be configured from cbox_decoder and the binary frame settings
+        // All of them are handed over to the acquisition session, which opens the serial ports,
+        // and the GUI starts draining the samples they acquire
 
-        if (ui->cbox_baud->currentText()=="1200")
+        const QStringList portNames = AcquisitionSession::splitPortNames(ui->cbox_ports->currentText());
+        if (portNames.isEmpty())
         {
-            external->setBaudRate(QSerialPort::Baud1200);
-        } else if (ui->cbox_baud->currentText()=="2400")
-        {
-            external->setBaudRate(QSerialPort::Baud2400);
-        } else if (ui->cbox_baud->currentText()=="4800")
-        {
-            external->setBaudRate(QSerialPort::Baud4800);
-        } else if (ui->cbox_baud->currentText()=="9600")
-        {
-            external->setBaudRate(QSerialPort::Baud9600);
-        } else if (ui->cbox_baud->currentText()=="19200")
+            ui->btn_getData->setChecked(false);
+            QMessageBox::warning(this, "Serial Port Error", "No serial port selected.");
+            return;
+        }
+
+        DecoderSettings settings;
+        QString decoderError;
+        if (!decoderSettings(settings, decoderError))
         {
-            external->setBaudRate(QSerialPort::Baud19200);
-        } else if (ui->cbox_baud->currentText()=="38400")
+            ui->btn_getData->setChecked(false);
+            QMessageBox::warning(this, "Decoder Error", decoderError + ".");
+            return;
+        }
+
+        // the processing chain is only built by the readers, but it is checked here so that
+        // a typo is reported once rather than by every port
+        QString processingError;
+        if (!SignalProcessor().setChain(settings.processing, processingError))
         {
-            external->setBaudRate(QSerialPort::Baud38400);
-        } else if (ui->cbox_baud->currentText()=="57600")
+            ui->btn_getData->setChecked(false);
+            QMessageBox::warning(this, "Processing Error", processingError);
+            return;
+        }
+
+        ui->btn_getData->setText("Stop");
+
+        // with Align ports, the ports are resampled onto a common timebase at the selected rate
+        // and plotted as a single one
+        aligning = ui->cbox_align->currentIndex() > 0;
+        if (aligning)
         {
-            external->setBaudRate(QSerialPort::Baud57600);
-        } else if (ui->cbox_baud->currentText()=="115200")
+            aligner.reset(portNames.size(), 1.0 / ui->spin_alignRate->value(),
+                          StreamAligner::Interpolation(ui->cbox_align->currentIndex() - 1));
+        }
+
+        // a capture being played back is closed, live data starts from scratch.
+        // So does the data of a different number of ports
+        const int plotted = aligning ? 1 : portNames.size();
+        if (playback != nullptr || plotted != ports.size())
         {
-            external->setBaudRate(QSerialPort::Baud115200);
+            clearData();
+            resetPorts(plotted);
         }
+        ui->btn_openCapture->setEnabled(false);
+        latency.clear();
 
-        external->setDataBits((QSerialPort::Data8));
-        external->setParity(QSerialPort::NoParity);
-        external->setStopBits(QSerialPort::OneStop);
-        external->setFlowControl(QSerialPort::NoFlowControl);
+        session->start(portNames, ui->cbox_baud->currentText().toInt(), settings);
 
-        QObject::connect(external, SIGNAL(readyRead()), this, SLOT(readSerial()));
+        scheduler->start();
+        ui->btn_record->setEnabled(true);
 
     } else
     {
         // If the button is initially checked i.e., its label reads "Stop",
         // its label will change to "Start"
-        // the serial port is closed
+        // the serial ports are closed by the acquisition session (which also stops recording)
+        // and the samples still in the ring buffers are plotted
         ui->btn_getData->setText("Start");
-        external->close();
+        ui->btn_record->setChecked(false);
+        ui->btn_record->setText("Record");
+        ui->btn_record->setEnabled(false);
+        ui->btn_openCapture->setEnabled(true);
+        session->stop();
+        scheduler->stop();
+        drainSamples();
 
     }
 }
 
-// Private method (slot) that reads the serial port when the push button
-// btn_getData is checked
+// Private method (slot) called by the render scheduler on every frame while reading the serial port
 //
-// This is the most hard coded function in the software:
-// It is set for serials that transmit double numbers separated by a comma.
-// It also has the specificity that it will only registed one every two values.
-// The reason is the tendency of arduino-like microcontrollers to transmit a weird first read value
-// The solution I found for this was to:
-// 1- store in a buffer sets of two values
-// 2- selected for these buffers of two values the last one
-void MainWindow::readSerial()
+// It pops all the samples the readers have pushed into the ring buffers since the last frame,
+// adds them to the ChannelBuffer pending of their port and plots the data once for the whole batch.
+// When aligning, the samples go to the aligner instead, and the rows it can resample so far are
+// added to the pending samples of the single port plotted
+void MainWindow::drainSamples()
 {
-    QStringList bufferSplit = serialBuffer.split(",");
+    std::size_t count = 0;
+    for (int port = 0; port < session->portCount() && (aligning || port < ports.size()); ++port)
+    {
+        count += session->ring(port).popAll([this, port](const Sample &sample) {
+            if (aligning)
+            {
+                aligner.add(port, sample.time * 1e-9, sample.values, sample.channels);
+            } else
+            {
+                addPoint(port, sample.time * 1e-9, sample.values, sample.channels);
+            }
+            latency.record(LatencyStats::Parse, sample.parsed - sample.received);
+            unplotted.append(qMakePair(sample.received, sample.parsed));
+        });
+    }
 
-    if (bufferSplit.length() < 3)
+    if (aligning)
     {
-        // if the buffer contains less than 3 values, keep storing read values in the buffer (as QStrings)
-        serialData = external->readAll();
-        serialBuffer += QString::fromStdString((serialData.toStdString()));
+        aligned.clear();
+        count = std::size_t(aligner.align(aligned));
+        QVector<double> row(aligned.channelCount());
+        for (int k = 0; k < aligned.size(); ++k)
+        {
+            for (int c = 0; c < row.size(); ++c)
+            {
+                row[c] = aligned.column(c)[k];
+            }
+            addPoint(0, aligned.keys()[k], row.constData(), row.size());
+        }
+    }
 
-    } else
+    if (count > 0)
     {
-        // if the buffer contains 3 values (2 numerical ones plus a comma):
-        // 1- select the second one i.e., bufferSplit[1]
-        // 2- transform this parameter, a QString, to a double
-        // 3- get the current time (a double, in seconds)
-        // 4- clean the buffer
-        // 5- add the time and signal values to the QVectors qv_time and qv_signal by calling addPoint()
-        // 6- plot the data
-        double y = bufferSplit[1].toDouble();
-        double x = QDateTime::currentDateTimeUtc().toTime_t();
-        serialBuffer = "";
-        addPoint(x, y);
         plot();
     }
 }
 
-// Public method that adds double values for the time and the registered signal
-// to the QVectors qv_time and qv_signal
-void MainWindow::addPoint(double x, double y)
+// Private method (slot) that shows the rendering statistics in the status bar, once per second
+//
+// When aligning ports, it also shows the sampling rate of every port estimated by the aligner
+void MainWindow::onRenderStats(double fps, quint64 droppedFrames)
+{
+    QString message = QString("Rendering at %1 fps | Dropped frames: %2 | Dropped samples: %3")
+            .arg(fps, 0, 'f', 1)
+            .arg(droppedFrames)
+            .arg(session->droppedSamples());
+    const quint64 overrun = session->overrunBytes();
+    if (overrun > 0)
+    {
+        // only simulated ports overrun
+        message += QString(" | Overrun bytes: %1").arg(overrun);
+    }
+    if (aligning)
+    {
+        QStringList rates;
+        for (int p = 0; p < aligner.streamCount(); ++p)
+        {
+            const double period = aligner.clockPeriod(p);
+            rates.append(period > 0 ? QString::number(1 / period, 'f', 2) : QString("-"));
+        }
+        message += " | Port rates (Hz): " + rates.join(", ");
+    }
+    ui->statusbar->showMessage(message);
+    ui->label_latency->setText(latency.summary());
+}
+
+// Private method (slot) called once every replot of plotWidget has been rasterized
+//
+// The samples plotted since the previous replot are now on screen. QCustomPlot also measures
+// how long the replot itself took (without the rasterization of the graphs in the background)
+void MainWindow::onPlotRendered()
+{
+    const qint64 rendered = LatencyStats::now();
+    for (int i = 0; i < unrendered.size(); ++i)
+    {
+        latency.record(LatencyStats::EndToEnd, rendered - unrendered[i].first);
+        latency.record(LatencyStats::Render, rendered - unrendered[i].second);
+    }
+    unrendered.clear();
+    latency.record(LatencyStats::Replot, qint64(ui->plotWidget->replotTime() * 1e6));
+}
+
+// Method to be executed if the push button btn_saveLatency is clicked
+//
+// Saves the latency percentiles and distributions measured since Start in a text file
+void MainWindow::on_btn_saveLatency_clicked()
+{
+    QString file_name = QFileDialog::getSaveFileName(this, "Choose a File", "C://", "Text files (*.txt)");
+    if (file_name.isEmpty())
+    {
+        return;
+    }
+    QString error;
+    if (!latency.save(file_name, error))
+    {
+        QMessageBox::warning(this, "Save Latency", "The latency could not be saved: " + error);
+    }
+}
+
+// Private method (slot) called when the frame rate is changed in spin_fps
+void MainWindow::on_spin_fps_valueChanged(int hz)
+{
+    scheduler->setFrameRate(hz);
+}
+
+// Private method (slot) called when a serial port can't be opened. The other ports are closed too
+void MainWindow::onReaderError(const QString &message)
+{
+    session->stop();
+    scheduler->stop();
+    ui->btn_getData->setChecked(false);
+    ui->btn_getData->setText("Start");
+    ui->btn_record->setChecked(false);
+    ui->btn_record->setText("Record");
+    ui->btn_record->setEnabled(false);
+    ui->btn_openCapture->setEnabled(true);
+    QMessageBox::warning(this, "Serial Port Error", message);
+}
+
+// Private method (slot) called when a different decoder is selected in cbox_decoder
+//
+// Frame layout, sync bytes, checksum and byte order only apply to binary frames
+void MainWindow::on_cbox_decoder_currentIndexChanged(int index)
+{
+    const bool binary = index >= DecoderSettings::BinaryStruct;
+    ui->edit_layout->setEnabled(binary);
+    ui->edit_sync->setEnabled(index == DecoderSettings::BinaryStruct);
+    ui->cbox_checksum->setEnabled(binary);
+    ui->chk_bigEndian->setEnabled(binary);
+}
+
+// Private method (slot) called when a different alignment is selected in cbox_align
+//
+// The aligned rate only applies when ports are aligned. Both take effect on the next Start
+void MainWindow::on_cbox_align_currentIndexChanged(int index)
+{
+    ui->spin_alignRate->setEnabled(index > 0);
+}
+
+// Private method (slot) called when a different time source is selected in cbox_timestamp
+//
+// The timestamp channel and its unit only apply to timestamps transmitted by the device
+void MainWindow::on_cbox_timestamp_currentIndexChanged(int index)
+{
+    ui->spin_tsChannel->setEnabled(index == DecoderSettings::DeviceTime);
+    ui->cbox_tsUnit->setEnabled(index == DecoderSettings::DeviceTime);
+}
+
+// Private method that reads the decoder settings from the ui.
+// Returns false, with the reason in error, if the binary frame layout or the sync bytes are not valid
+bool MainWindow::decoderSettings(DecoderSettings &settings, QString &error)
+{
+    settings.type = DecoderSettings::Type(ui->cbox_decoder->currentIndex());
+    settings.checksum = DecoderSettings::Checksum(ui->cbox_checksum->currentIndex());
+    settings.littleEndian = !ui->chk_bigEndian->isChecked();
+    settings.timeSource = DecoderSettings::TimeSource(ui->cbox_timestamp->currentIndex());
+    settings.timestampChannel = ui->spin_tsChannel->value() - 1;
+    static const double units[] = {1.0, 1e-3, 1e-6, 1e-9};
+    settings.timestampScale = units[qBound(0, ui->cbox_tsUnit->currentIndex(), 3)];
+    settings.processing = ui->edit_processing->text().trimmed();
+
+    if (settings.type >= DecoderSettings::BinaryStruct
+        && !DecoderSettings::parseLayout(ui->edit_layout->text(), settings.fields))
+    {
+        error = "The frame layout is not valid";
+        return false;
+    }
+    if (settings.type == DecoderSettings::BinaryStruct
+        && !DecoderSettings::parseSyncBytes(ui->edit_sync->text(), settings.syncBytes))
+    {
+        error = "The sync bytes are not valid";
+        return false;
+    }
+    return settings.validate(error);
+}
+
+// Public method that adds the time and the values of all channels of a sample of port
+// to its ChannelBuffer pending, to be appended to its graphs in the next call to plot()
+void MainWindow::addPoint(int port, double x, const double *values, int count)
 {
     // If it is the first read value, it initiates the time offset (t0)
-    if (qv_time.size()==0){
-        t0 = QDateTime::currentDateTimeUtc().toTime_t();
+    if (!t0_set){
+        t0 = x;
+        t0_set = true;
+    }
+
+    // It appends the time passed with respect to the offset t0 (common to all ports)
+    ports[port].pending.append(x-t0, values, count);
+
+    // Updates the labels timeLabel and signalLabel with the most recent values (of the first channel of the first port)
+    if (port == 0)
+    {
+        ui->timeLabel->setText(QString::number(x-t0, 'f', 3));
+        if (count > 0)
+        {
+            ui->signalLabel->setText(QString::number(values[0], 'f', 3));
+        }
+    }
+}
+
+// Private method that restores the initial plot for count ports
+//
+// All graphs are removed but the original scatter plot, which becomes the first channel of the
+// first port. The graphs of the other channels and ports are added as their samples arrive
+void MainWindow::resetPorts(int count)
+{
+    QCustomPlot *plot = ui->plotWidget;
+    plot->clearGraphs();
+    plot->addGraph();
+    plot->graph(0)->setScatterStyle(QCPScatterStyle::ssCircle);
+    plot->legend->setVisible(false);
+
+    ports.clear();
+    ports.resize(qMax(count, 1));
+    ports[0].graphs.append(plot->graph(0));
+    for (int i = 0; i < ports.size(); ++i)
+    {
+        ports[i].range.setWindowed(ui->cbox_window->currentIndex() > wmUnlimited);
     }
+}
 
-    // It appends the time passed with respect to the offset t0
-    qv_time.append(x-t0);
+// Private method that makes sure plotWidget has one graph per channel of port
+//
+// A single channel is drawn as the original scatter plot. With several channels, each
+// graph gets its own color and name in the legend, and scatters are dropped for speed.
+// Graphs of channels that appear in the middle of an acquisition are filled with NaN (gaps)
+// at the keys already plotted, so the data of all graphs of a port stays aligned row by row.
+// Different ports are sampled at different times, so each port keeps its own keys
+void MainWindow::updateGraphs(int port, int count)
+{
+    QCustomPlot *plot = ui->plotWidget;
+    QVector<QCPGraph *> &graphs = ports[port].graphs;
+    if (count <= graphs.size())
+    {
+        return;
+    }
 
-    qv_signal.append(y);
+    QVector<double> keys;
+    if (!graphs.isEmpty())
+    {
+        QSharedPointer<QCPGraphDataContainer> data = graphs[0]->data();
+        keys.reserve(data->size());
+        for (QCPGraphDataContainer::const_iterator it = data->constBegin(); it != data->constEnd(); ++it)
+        {
+            keys.append(it->key);
+        }
+    }
+    const QVector<double> gaps(keys.size(), std::numeric_limits<double>::quiet_NaN());
 
-    // Updates the labels timeLabel and signalLabel with the most recent values
-    ui->timeLabel->setText(QString::number(x-t0, 'f', 2));
-    ui->signalLabel->setText(QString::number(y, 'f', 3));
+    while (graphs.size() < count)
+    {
+        graphs.append(plot->addGraph());
+        graphs.last()->addData(keys, gaps, true);
+    }
+
+    const int total = plot->graphCount();
+    const bool multiChannel = total > 1;
+    int index = 0;
+    for (int p = 0; p < ports.size(); ++p)
+    {
+        for (int i = 0; i < ports[p].graphs.size(); ++i, ++index)
+        {
+            QCPGraph *graph = ports[p].graphs[i];
+            graph->setName(channelName(p, i));
+            graph->setScatterStyle(multiChannel ? QCPScatterStyle::ssNone : QCPScatterStyle::ssCircle);
+            graph->setPen(QPen(multiChannel ? QColor::fromHsv((index * 360 / total) % 360, 220, 200) : QColor(Qt::blue)));
+        }
+    }
+    plot->legend->setVisible(multiChannel);
+}
+
+// Private method that gives the name of a channel of a port in the legend
+//
+// When aligning, the single port plotted holds the channels of all ports read, one port after the other
+QString MainWindow::channelName(int port, int channel) const
+{
+    const QStringList &names = session->portNames();
+    if (aligning && names.size() > 1)
+    {
+        for (int p = 0; p < aligner.streamCount(); ++p)
+        {
+            if (channel < aligner.channelCount(p))
+            {
+                return QString("%1 channel %2").arg(names.value(p)).arg(channel + 1);
+            }
+            channel -= aligner.channelCount(p);
+        }
+    }
+    if (ports.size() > 1)
+    {
+        return QString("%1 channel %2").arg(names.value(port)).arg(channel + 1);
+    }
+    return QString("Channel %1").arg(channel + 1);
 }
 
-// Public method to plot the QVectors qv_time and qv_signal in plotWidget
+// Public method to plot the samples in plotWidget
+//
+// Only the samples received since the last call (those in pending) are appended to the graphs,
+// one batch per channel. The data containers of the graphs are the only copy of the data:
+// appending sorted keys to them costs the same regardless of how much data they already hold
 void MainWindow::plot()
 {
-    ui->plotWidget->graph(0)->setData(qv_time, qv_signal);
+    for (int p = 0; p < ports.size(); ++p)
+    {
+        PortPlot &port = ports[p];
+        const ChannelBuffer &pending = port.pending;
+        updateGraphs(p, pending.channelCount());
 
-    // updates the plot range for better view
-    double min_y = *std::min_element(qv_signal.begin(), qv_signal.end());
-    double max_y = *std::max_element(qv_signal.begin(), qv_signal.end());
+        for (int i = 0; i < pending.channelCount(); ++i)
+        {
+            port.graphs[i]->addData(pending.keys(), pending.column(i), true);
+        }
+        // channels that are not transmitted anymore get gaps, to keep all graphs of the port aligned
+        if (pending.channelCount() < port.graphs.size() && !pending.isEmpty())
+        {
+            const QVector<double> gaps(pending.size(), std::numeric_limits<double>::quiet_NaN());
+            for (int i = pending.channelCount(); i < port.graphs.size(); ++i)
+            {
+                port.graphs[i]->addData(pending.keys(), gaps, true);
+            }
+        }
+
+        // Only the new values are fed to the range tracker, so autoscaling costs the same
+        // regardless of the amount of data plotted
+        for (int k = 0; k < pending.size(); ++k)
+        {
+            for (int i = 0; i < pending.channelCount(); ++i)
+            {
+                port.range.add(pending.keys()[k], pending.column(i)[k]);
+            }
+        }
+        port.pending.clear();
+    }
+
+    // The samples are now in the graphs, and will be shown by the next replot
+    const qint64 plotted = LatencyStats::now();
+    for (int i = 0; i < unplotted.size(); ++i)
+    {
+        latency.record(LatencyStats::Queue, plotted - unplotted[i].second);
+        unrendered.append(qMakePair(unplotted[i].first, plotted));
+    }
+    unplotted.clear();
+
+    applyWindow();
+
+    // the time span and the range of the values of all ports with data
+    bool empty = true;
+    double first_x = std::numeric_limits<double>::infinity();
+    double last_x = -first_x;
+    double min_y = first_x;
+    double max_y = -first_x;
+    for (int p = 0; p < ports.size(); ++p)
+    {
+        const PortPlot &port = ports[p];
+        if (port.graphs.isEmpty() || port.graphs[0]->data()->isEmpty())
+        {
+            continue;
+        }
+        empty = false;
+        first_x = qMin(first_x, port.graphs[0]->data()->constBegin()->key);
+        last_x = qMax(last_x, port.range.lastKey());
+        if (!port.range.isEmpty())
+        {
+            min_y = qMin(min_y, port.range.minimum());
+            max_y = qMax(max_y, port.range.maximum());
+        }
+    }
+
+    if (empty)
+    {
+        ui->plotWidget->replot(QCustomPlot::rpQueuedReplot);
+        return;
+    }
+
+    // updates the plot range for better view (NaN values, i.e. missing channels, are skipped)
+    if (min_y > max_y)
+    {
+        min_y = 0;
+        max_y = 0;
+    }
     double range_y = (max_y - min_y)/2;
     if (range_y == 0 || range_y == 0.0)
     {
@@ -185,16 +589,117 @@ void MainWindow::plot()
         min_y = min_y - range_y * 0.1;
         max_y = max_y + range_y * 0.1;
     }
-    ui->plotWidget->xAxis->setRange(0, *std::max_element(qv_time.begin(), qv_time.end())+1);
+    if (ui->cbox_window->currentIndex() == wmUnlimited)
+    {
+        ui->plotWidget->xAxis->setRange(0, last_x+1);
+    } else
+    {
+        // the x axis scrolls with the window
+        ui->plotWidget->xAxis->setRange(first_x, last_x);
+    }
     ui->plotWidget->yAxis->setRange(min_y, max_y);
 
-    ui->plotWidget->replot();
-    ui->plotWidget->update();
+    // The replot is queued, so several calls within the same event loop iteration
+    // (e.g. a frame and a click on Clear) only render once
+    ui->plotWidget->replot(QCustomPlot::rpQueuedReplot);
+}
+
+// Private method that evicts the data that fell out of the plot window
+//
+// In the windowed modes only the last N seconds (of all ports) or N samples (of every port)
+// are kept, so memory use and replot cost stay bounded however long the acquisition runs.
+// The data containers don't free the removed points but reuse their storage for the points
+// appended next
+void MainWindow::applyWindow()
+{
+    const int mode = ui->cbox_window->currentIndex();
+    if (mode == wmUnlimited)
+    {
+        return;
+    }
+
+    double latest = -std::numeric_limits<double>::infinity();
+    for (int p = 0; p < ports.size(); ++p)
+    {
+        if (!ports[p].graphs.isEmpty() && !ports[p].graphs[0]->data()->isEmpty())
+        {
+            latest = qMax(latest, (ports[p].graphs[0]->data()->constEnd()-1)->key);
+        }
+    }
+
+    for (int p = 0; p < ports.size(); ++p)
+    {
+        PortPlot &port = ports[p];
+        if (port.graphs.isEmpty() || port.graphs[0]->data()->isEmpty())
+        {
+            continue;
+        }
+        QCPGraphDataContainer *data = port.graphs[0]->data().data();
+
+        double cutoff;
+        if (mode == wmSeconds)
+        {
+            cutoff = latest - ui->spin_window->value();
+        } else
+        {
+            if (data->size() <= ui->spin_window->value())
+            {
+                continue;
+            }
+            cutoff = data->at(data->size() - ui->spin_window->value())->key;
+        }
+
+        for (int i = 0; i < port.graphs.size(); ++i)
+        {
+            port.graphs[i]->data()->removeBefore(cutoff);
+        }
+        port.range.removeBefore(cutoff);
+    }
+}
+
+// Private method (slot) called when a different plot window is selected in cbox_window
+//
+// The range tracker switches between running extrema and sliding window extrema,
+// and is fed again with the data currently plotted
+void MainWindow::on_cbox_window_currentIndexChanged(int index)
+{
+    ui->spin_window->setEnabled(index != wmUnlimited);
+    for (int p = 0; p < ports.size(); ++p)
+    {
+        ports[p].range.setWindowed(index != wmUnlimited);
+    }
+    if (ui->plotWidget->graphCount() == 0 || playback != nullptr)
+    {
+        return;
+    }
+
+    applyWindow();
+    bool empty = true;
+    for (int p = 0; p < ports.size(); ++p)
+    {
+        const QVector<QCPGraph *> &graphs = ports[p].graphs;
+        if (graphs.isEmpty())
+        {
+            continue;
+        }
+        for (int i = 0; i < graphs[0]->data()->size(); ++i)
+        {
+            for (int c = 0; c < graphs.size(); ++c)
+            {
+                ports[p].range.add(graphs[c]->data()->at(i)->key, graphs[c]->data()->at(i)->value);
+            }
+        }
+        empty = empty && graphs[0]->data()->isEmpty();
+    }
+    if (!empty)
+    {
+        plot();
+    }
 }
 
 // Method to be executed if the push button btn_clear is clicked
 //
-// It empties the QVectors qv_time and qv_signal and clears the plotWidget
+// It empties the graphs and clears the plotWidget
 void MainWindow::on_btn_clear_clicked()
 {
     clearData();
@@ -202,33 +707,156 @@ void MainWindow::on_btn_clear_clicked()
 }
 
 // Method, call when clicking btn_clear, that:
-// 1- Clears the QVectors qv_time and qv_signal
-// 2- Clears the text form the labels timeLabel and signalLabel
+// 1- Closes the capture file being played back, if any, and restores the live graph
+// 2- Clears the ChannelBuffer pending, the range and the data of every graph of every port
+// 3- Clears the text form the labels timeLabel and signalLabel
 void MainWindow::clearData()
 {
-    qv_time.clear();
-    qv_signal.clear();
+    if (playback != nullptr)
+    {
+        delete playback;
+        playback = nullptr;
+        resetPorts(ports.size());
+        ui->btn_saveData->setEnabled(exportThread == nullptr);
+    }
+    unplotted.clear();
+    for (int p = 0; p < ports.size(); ++p)
+    {
+        ports[p].pending.clear();
+        ports[p].range.clear();
+        for (int i = 0; i < ports[p].graphs.size(); ++i)
+        {
+            ports[p].graphs[i]->data()->clear();
+        }
+    }
+    t0_set = false;
     ui->timeLabel->setText("-");
     ui->signalLabel->setText("-");
 }
 
+// Method to be executed if the push button btn_record is clicked
+//
+// btn_record is a checkeable push button, only enabled while reading the serial port.
+// When checked, every sample acquired from then on is also written to a capture file
+// by the reader threads (one file per port), until it is unchecked or the serial ports are closed
+void MainWindow::on_btn_record_clicked()
+{
+    if (ui->btn_record->isChecked())
+    {
+        QString file_name = QFileDialog::getSaveFileName(this, "Choose a Capture File", "C://", "Captures (*.srcap)");
+        if (file_name.isEmpty())
+        {
+            ui->btn_record->setChecked(false);
+            return;
+        }
+        ui->btn_record->setText("Stop Recording");
+        session->startRecording(file_name);
+    } else
+    {
+        ui->btn_record->setText("Record");
+        session->stopRecording();
+    }
+}
+
+// Private method (slot) called if the capture file can't be created or written
+void MainWindow::onRecordingError(const QString &message)
+{
+    ui->btn_record->setChecked(false);
+    ui->btn_record->setText("Record");
+    QMessageBox::warning(this, "Recording Error", "Recording stopped: " + message);
+}
+
+// Method to be executed if the push button btn_openCapture is clicked
+//
+// Shows a capture file written by Record instead of live data, until Clear or Start is clicked.
+// The file is not loaded: panning and zooming read just the visible part of it (see CapturePlayback)
+void MainWindow::on_btn_openCapture_clicked()
+{
+    QString file_name = QFileDialog::getOpenFileName(this, "Open a Capture File", "C://", "Captures (*.srcap)");
+    if (file_name.isEmpty())
+    {
+        return;
+    }
+
+    clearData();
+    playback = new CapturePlayback(ui->plotWidget, this);
+    if (!playback->open(file_name))
+    {
+        QMessageBox::warning(this, "Open Recording", "The capture file could not be opened: " + playback->errorString());
+        clearData();
+        plot();
+        return;
+    }
+
+    // the graphs only hold the visible part of the capture, so there is nothing sensible to save
+    ui->btn_saveData->setEnabled(false);
+    ui->timeLabel->setText(QString::number(playback->duration(), 'f', 3));
+    ui->statusbar->showMessage(QString("%1: %2 frames, %3 channels, recorded %4")
+                               .arg(QFileInfo(file_name).fileName())
+                               .arg(playback->capture().frameCount())
+                               .arg(playback->capture().channelCount())
+                               .arg(QDateTime::fromMSecsSinceEpoch(playback->capture().startTime()).toString(Qt::ISODate)));
+}
+
 // Method to be executed if the push button btn_saveData is clicked
 //
-// Saves the QVectors qv_time and qv_signal in a csv file
+// Saves the time and the values of every channel of every port (as stored in the graphs) in a csv file.
+// The file is written by a CsvExporter in a worker thread, from a snapshot of the graphs taken
+// now, while a progress dialog allows cancelling it. Acquisition and plotting go on meanwhile
 void MainWindow::on_btn_saveData_clicked()
 {
+    if (exportThread != nullptr)
+    {
+        return;
+    }
+
     QString file_name = QFileDialog::getSaveFileName(this, "Choose a File", "C://");
-    QFile file(file_name);
+    if (file_name.isEmpty())
+    {
+        return;
+    }
 
-    if (file.open(QFile::WriteOnly | QFile::Text)){
-        QTextStream stream(&file);
-        stream << "Time (s)" << "," << "Signal\n";
-        for (int i=0; i< qv_time.size(); i++){
-            stream << qv_time[i] << "," << qv_signal[i] << "\n";
+    QVector<QVector<QCPGraphDataContainer> > snapshot(ports.size());
+    for (int p = 0; p < ports.size(); p++)
+    {
+        for (int c = 0; c < ports[p].graphs.size(); c++)
+        {
+            snapshot[p].append(*ports[p].graphs[c]->data());
         }
-
     }
 
-    file.close();
+    exportThread = new QThread(this);
+    exporter = new CsvExporter(file_name, snapshot, session->portNames());
+    exporter->moveToThread(exportThread);
+    QObject::connect(exportThread, &QThread::started, exporter, &CsvExporter::run);
+    QObject::connect(exportThread, &QThread::finished, exporter, &QObject::deleteLater);
+    QObject::connect(exporter, &CsvExporter::finished, this, &MainWindow::onExportFinished);
+
+    exportProgress = new QProgressDialog("Saving data...", "Cancel", 0, 100, this);
+    exportProgress->setWindowModality(Qt::WindowModal);
+    exportProgress->setMinimumDuration(500);
+    QObject::connect(exporter, &CsvExporter::progress, exportProgress, &QProgressDialog::setValue);
+    QObject::connect(exportProgress, &QProgressDialog::canceled, exporter, &CsvExporter::cancel, Qt::DirectConnection);
+
+    ui->btn_saveData->setEnabled(false);
+    exportThread->start();
 }
 
+// Private method (slot) called when the csv export has finished, failed or been cancelled
+void MainWindow::onExportFinished(bool ok, const QString &error)
+{
+    exportThread->quit();
+    exportThread->wait();
+    delete exportThread;
+    exportThread = nullptr;
+    exporter = nullptr;
+
+    exportProgress->deleteLater();
+    exportProgress = nullptr;
+    ui->btn_saveData->setEnabled(playback == nullptr);
+
+    if (!ok && !error.isEmpty())
+    {
+        QMessageBox::warning(this, "Save Data", "The data could not be saved: " + error);
+    }
+}
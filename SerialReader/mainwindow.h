@@ -11,6 +11,22 @@
 #include <QMessageBox>
 #include <string>
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QFontDatabase>
+#include <QThread>
+#include <QProgressDialog>
+
+#include "acquisitionsession.h"
+#include "captureplayback.h"
+#include "channelbuffer.h"
+#include "csvexporter.h"
+#include "framedecoder.h"
+#include "latencystats.h"
+#include "rangetracker.h"
+#include "renderscheduler.h"
+#include "sample.h"
+#include "signalprocessor.h"
+#include "streamaligner.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -25,7 +41,7 @@ public:
     MainWindow(QWidget *parent = nullptr); // Constructor
     ~MainWindow();  // Destructor
 
-    void addPoint(double x, double y);
+    void addPoint(int port, double x, const double *values, int count);
     void clearData();
     void plot();
 
@@ -36,22 +52,100 @@ private slots:
 
     void on_btn_saveData_clicked();
 
-    void readSerial();
+    void on_btn_record_clicked();
+
+    void onRecordingError(const QString &message);
+
+    void on_btn_openCapture_clicked();
+
+    void drainSamples();
+
+    void onRenderStats(double fps, quint64 droppedFrames);
+
+    void onPlotRendered();
+
+    void on_btn_saveLatency_clicked();
+
+    void on_spin_fps_valueChanged(int hz);
+
+    void on_cbox_window_currentIndexChanged(int index);
+
+    void onExportFinished(bool ok, const QString &error);
+
+    void onReaderError(const QString &message);
+
+    void on_cbox_decoder_currentIndexChanged(int index);
+
+    void on_cbox_timestamp_currentIndexChanged(int index);
+
+    void on_cbox_align_currentIndexChanged(int index);
 
 private:
+    // Data shown in the plot: everything since the last Clear, or only the most recent data
+    enum WindowMode { wmUnlimited, wmSeconds, wmSamples };
+
+    bool decoderSettings(DecoderSettings &settings, QString &error);
+
+    // Plot data of a port
+    struct PortPlot
+    {
+        // Graphs of its channels
+        QVector<QCPGraph *> graphs;
+
+        // Samples not plotted yet. Once plotted, the data containers of the graphs hold them
+        ChannelBuffer pending;
+
+        // Range of the plotted values, used to autoscale the axes
+        RangeTracker range;
+    };
+
+    void resetPorts(int count);
+
+    void updateGraphs(int port, int count);
+
+    QString channelName(int port, int channel) const;
+
+    void applyWindow();
+
     Ui::MainWindow *ui;
 
-    QVector<double> qv_time, qv_signal;
+    // Plot data of every port read (in the order of the names in cbox_ports)
+    QVector<PortPlot> ports;
 
     double t0;
 
-    QSerialPort *external;
+    bool t0_set;
+
+    // Reads the serial ports in its own threads
+    AcquisitionSession *session;
+
+    // With Align ports, the samples of all ports are resampled onto a common timebase by the aligner
+    // and plotted as the channels of a single port. aligned receives the rows it resamples
+    bool aligning;
+
+    StreamAligner aligner;
+
+    ChannelBuffer aligned;
+
+    RenderScheduler *scheduler;
+
+    // Thread, worker and progress dialog of the csv export in progress (null otherwise)
+    QThread *exportThread;
+
+    CsvExporter *exporter;
+
+    QProgressDialog *exportProgress;
+
+    // Capture file shown in the plot (null while showing live data)
+    CapturePlayback *playback;
 
-    QString serial_port_name;
+    // Latencies of the acquired samples, and the times (LatencyStats::now()) of the samples
+    // drained but not plotted yet (received, decoded) and plotted but not shown yet (received, plotted)
+    LatencyStats latency;
 
-    QByteArray serialData;
+    QVector<QPair<qint64, qint64> > unplotted;
 
-    QString serialBuffer;
+    QVector<QPair<qint64, qint64> > unrendered;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,94 @@
+// Definition of the fast number formatting function
+
+#include "numberformat.h"
+
+#include <cmath>
+#include <cstdio>
+
+
+namespace {
+
+const double powersOfTen[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+};
+
+}
+
+int formatDouble(double value, int significantDigits, char *out)
+{
+    if (std::isnan(value))
+    {
+        out[0] = 'n'; out[1] = 'a'; out[2] = 'n';
+        return 3;
+    }
+    if (value == 0)
+    {
+        out[0] = '0';
+        return 1;
+    }
+    if (significantDigits < 1) significantDigits = 1;
+    if (significantDigits > 17) significantDigits = 17;
+
+    char *p = out;
+    double magnitude = value;
+    if (magnitude < 0)
+    {
+        *p++ = '-';
+        magnitude = -magnitude;
+    }
+
+    // Fast path: 1e-4 <= |value| < 1e15, scaled to an integer of significantDigits digits at most
+    if (magnitude >= 1e-4 && magnitude < 1e15)
+    {
+        int exponent = 0;   // floor(log10(magnitude)) for magnitude >= 1
+        while (exponent < 15 && magnitude >= powersOfTen[exponent + 1])
+        {
+            ++exponent;
+        }
+        if (magnitude < 1)
+        {
+            exponent = -1;
+            while (magnitude * powersOfTen[-exponent] < 1)
+            {
+                --exponent;
+            }
+        }
+
+        const int decimals = significantDigits - 1 - exponent;
+        if (decimals >= 0 && decimals <= 18)
+        {
+            unsigned long long scaled = (unsigned long long)std::llround(magnitude * powersOfTen[decimals]);
+            int shownDecimals = decimals;
+            while (shownDecimals > 0 && scaled % 10 == 0)
+            {
+                scaled /= 10;
+                --shownDecimals;
+            }
+
+            char digits[24];
+            int n = 0;
+            do
+            {
+                digits[n++] = char('0' + scaled % 10);
+                scaled /= 10;
+            } while (scaled != 0);
+            while (n <= shownDecimals)
+            {
+                digits[n++] = '0';  // leading zeros of numbers below 1
+            }
+
+            for (int i = n - 1; i >= 0; --i)
+            {
+                *p++ = digits[i];
+                if (i == shownDecimals && i > 0)
+                {
+                    *p++ = '.';
+                }
+            }
+            return int(p - out);
+        }
+    }
+
+    return std::snprintf(out, 32, "%.*g", significantDigits, value);
+}
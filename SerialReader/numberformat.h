@@ -0,0 +1,11 @@
+#ifndef NUMBERFORMAT_H
+#define NUMBERFORMAT_H
+
+// Writes value as text into out with at most significantDigits significant digits (1 to 17),
+// trailing zeros removed, and returns the number of characters written (never more than 32).
+// Numbers of usual magnitude are formatted with integer arithmetic, which is several times faster
+// than printf-like functions; very large or very small ones fall back to scientific notation.
+// The output does not depend on the locale. NaN is written as "nan".
+int formatDouble(double value, int significantDigits, char *out);
+
+#endif // NUMBERFORMAT_H
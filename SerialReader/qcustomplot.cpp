@@ -25,6 +25,24 @@
 
 #include "qcustomplot.h"
 
+#include <QtCore/QRunnable>
+#include <QtCore/QSemaphore>
+#include <QtCore/QThreadPool>
+#include <QtGui/QImage>
+#include <QtGui/QPicture>
+
+// SIMD instruction sets used by the batch coordinate transforms (see QCPAxis::coordsToPixels).
+// They are picked at compile time: SSE2 is always available on x86-64, AVX when the compiler
+// targets it (e.g. QMAKE_CXXFLAGS += -mavx2). Other targets use the scalar code
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define QCP_SIMD_SSE2
+#  include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#  define QCP_SIMD_AVX
+#  include <immintrin.h>
+#endif
+
 
 /* including file 'src/vector2d.cpp'       */
 /* modified 2021-03-29T02:30:44, size 7973 */
@@ -9345,6 +9363,68 @@ double QCPAxis::coordToPixel(double value) const
   }
 }
 
+/*!
+  Transforms \a count values in axis coordinates to pixel coordinates of the QCustomPlot widget,
+  like \ref coordToPixel does for a single value. The values are read from \a coords, every \a
+  coordStride-th double, and the pixels written to \a pixels, every \a pixelStride-th double (so
+  that e.g. the keys of QCPGraphData or the x coordinates of QPointF can be transformed in place).
+
+  The parameters of the axis are only read once, which makes transforming many values (e.g. all
+  data points of a plottable on every replot) much faster than calling \ref coordToPixel for each of
+  them. On linear axes with contiguous values, the loop is vectorized by the compiler.
+
+  \see coordToPixelTransform
+*/
+void QCPAxis::coordsToPixels(const double *coords, double *pixels, int count, int coordStride, int pixelStride) const
+{
+  double origin, scale, offset;
+  coordToPixelTransform(origin, scale, offset);
+  if (mScaleType == stLinear)
+  {
+    if (coordStride == 1 && pixelStride == 1)
+    {
+      for (int i=0; i<count; ++i)
+        pixels[i] = (coords[i]-origin)*scale+offset;
+    } else
+    {
+      for (int i=0; i<count; ++i)
+        pixels[i*pixelStride] = (coords[i*coordStride]-origin)*scale+offset;
+    }
+  } else // mScaleType == stLogarithmic
+  {
+    // values of the wrong sign for the range are drawn outside the visible range, as by coordToPixel
+    const double invalidPixel = coordToPixel(0.0);
+    const bool positiveRange = mRange.upper >= 0.0;
+    const double originInverse = 1.0/origin;
+    for (int i=0; i<count; ++i)
+    {
+      const double value = coords[i*coordStride];
+      if (positiveRange ? value <= 0.0 : value >= 0.0)
+        pixels[i*pixelStride] = invalidPixel;
+      else
+        pixels[i*pixelStride] = qLn(value*originInverse)*scale+offset;
+    }
+  }
+}
+
+/*!
+  Returns the parameters of the transform from axis coordinates to pixels: on linear axes, a
+  coordinate \a c is at pixel (c-\a origin)*\a scale+\a offset, and on logarithmic axes at
+  ln(c/\a origin)*\a scale+\a offset (for coordinates of the same sign as the range). They take
+  the orientation of the axis and whether its range is reversed into account.
+
+  This is meant for transforming many coordinates at once, see \ref coordsToPixels.
+*/
+void QCPAxis::coordToPixelTransform(double &origin, double &scale, double &offset) const
+{
+  const bool horizontal = orientation() == Qt::Horizontal;
+  const double length = horizontal ? mAxisRect->width() : mAxisRect->height();
+  const double span = mScaleType == stLinear ? mRange.size() : qLn(mRange.upper/mRange.lower);
+  origin = mRangeReversed ? mRange.upper : mRange.lower;
+  scale = (mRangeReversed == horizontal ? -length : length)/span;
+  offset = horizontal ? mAxisRect->left() : mAxisRect->bottom();
+}
+
 /*!
   Returns the part of the axis that is hit by \a pos (in pixels). The return value of this function
   is independent of the user-selectable parts defined with \ref setSelectableParts. Further, this
@@ -11317,6 +11397,25 @@ bool QCPSelectionDecorator::registerWithPlottable(QCPAbstractPlottable *plottabl
   abstract base class only.
 */
 
+/*! \fn virtual void QCPAbstractPlottable::prepareGeometry()
+  \internal
+  
+  Called by \ref QCustomPlot::replot before the layers are drawn, on a thread of the global
+  QThreadPool and concurrently with the other plottables. Plottables can reimplement it to compute
+  the pixel geometry of their data ahead of \ref draw, which then only paints it. Reimplementations
+  must only read the plottable, its data and its axes. The default implementation does nothing.
+  
+  \see discardGeometry
+*/
+
+/*! \fn virtual void QCPAbstractPlottable::discardGeometry()
+  \internal
+  
+  Called by \ref QCustomPlot::replot after the layers are drawn, to release the geometry computed
+  by \ref prepareGeometry, in case \ref draw wasn't called. The default implementation does
+  nothing.
+*/
+
 /* end of documentation of inline functions */
 /* start of documentation of pure virtual functions */
 
@@ -11655,6 +11754,103 @@ const QPointF QCPAbstractPlottable::coordsToPixels(double key, double value) con
     return QPointF(valueAxis->coordToPixel(value), keyAxis->coordToPixel(key));
 }
 
+/*! \internal
+
+  Transforms the \a count coordinate pairs at \a coords to pixels at \a pixels (which may be \a
+  coords itself), as (c-origin)*scale+offset with the origin, scale and offset of each coordinate
+  of a pair given as two-element arrays. With \a swap, the two coordinates of every pair are
+  swapped before being transformed, and \a origin, \a scale and \a offset are those of the pixels.
+
+  A 256-bit AVX register holds two pairs and a 128-bit SSE2 register one, so the transform of each
+  pair costs a few instructions, without any branch.
+*/
+static void qcpTransformPairs(const double *coords, double *pixels, int count, const double *origin, const double *scale, const double *offset, bool swap)
+{
+  int i = 0;
+#if defined(QCP_SIMD_AVX)
+  const __m256d origin4 = _mm256_setr_pd(origin[0], origin[1], origin[0], origin[1]);
+  const __m256d scale4 = _mm256_setr_pd(scale[0], scale[1], scale[0], scale[1]);
+  const __m256d offset4 = _mm256_setr_pd(offset[0], offset[1], offset[0], offset[1]);
+  for (; i+2 <= count; i += 2)
+  {
+    __m256d v = _mm256_loadu_pd(coords+2*i);
+    if (swap)
+      v = _mm256_permute_pd(v, 0x5);
+    _mm256_storeu_pd(pixels+2*i, _mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(v, origin4), scale4), offset4));
+  }
+#endif
+#if defined(QCP_SIMD_SSE2)
+  const __m128d origin2 = _mm_setr_pd(origin[0], origin[1]);
+  const __m128d scale2 = _mm_setr_pd(scale[0], scale[1]);
+  const __m128d offset2 = _mm_setr_pd(offset[0], offset[1]);
+  for (; i < count; ++i)
+  {
+    __m128d v = _mm_loadu_pd(coords+2*i);
+    if (swap)
+      v = _mm_shuffle_pd(v, v, 1);
+    _mm_storeu_pd(pixels+2*i, _mm_add_pd(_mm_mul_pd(_mm_sub_pd(v, origin2), scale2), offset2));
+  }
+#endif
+  for (; i < count; ++i)
+  {
+    const double a = coords[2*i+(swap ? 1 : 0)];
+    const double b = coords[2*i+(swap ? 0 : 1)];
+    pixels[2*i] = (a-origin[0])*scale[0]+offset[0];
+    pixels[2*i+1] = (b-origin[1])*scale[1]+offset[1];
+  }
+}
+
+/*! \overload
+
+  Transforms the \a count key/value pairs at \a keyValues (key first, e.g. the memory of a
+  QVector<QCPGraphData>) to pixels, written to \a pixels. \a pixels may point to \a keyValues, so
+  that pairs stored as QPointF can be transformed in place.
+
+  The axis parameters are read once for all pairs (see \ref QCPAxis::coordsToPixels). When both axes
+  are linear, each pair is transformed with SIMD instructions where available, which makes
+  transforming the points of large plottables several times faster than calling \ref
+  coordsToPixels for each of them.
+*/
+void QCPAbstractPlottable::coordsToPixels(const double *keyValues, QPointF *pixels, int count) const
+{
+  QCPAxis *keyAxis = mKeyAxis.data();
+  QCPAxis *valueAxis = mValueAxis.data();
+  if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
+  if (count <= 0)
+    return;
+  
+  const bool swap = keyAxis->orientation() != Qt::Horizontal;
+  if (sizeof(qreal) != sizeof(double)) // QPointF of floats, can't be written as pairs of doubles
+  {
+    for (int i=0; i<count; ++i)
+      pixels[i] = coordsToPixels(keyValues[2*i], keyValues[2*i+1]);
+    return;
+  }
+  double *out = reinterpret_cast<double*>(pixels);
+  
+  if (keyAxis->scaleType() == QCPAxis::stLinear && valueAxis->scaleType() == QCPAxis::stLinear)
+  {
+    double origin[2], scale[2], offset[2];
+    QCPAxis *xAxis = swap ? valueAxis : keyAxis;
+    QCPAxis *yAxis = swap ? keyAxis : valueAxis;
+    xAxis->coordToPixelTransform(origin[0], scale[0], offset[0]);
+    yAxis->coordToPixelTransform(origin[1], scale[1], offset[1]);
+    qcpTransformPairs(keyValues, out, count, origin, scale, offset, swap);
+  } else
+  {
+    // with swapped coordinates, transforming in place would overwrite values before they are read
+    QVector<double> copy;
+    if (swap && keyValues == out)
+    {
+      copy = QVector<double>(2*count);
+      std::copy(keyValues, keyValues+2*count, copy.begin());
+      keyValues = copy.constData();
+    }
+    keyAxis->coordsToPixels(keyValues, out+(swap ? 1 : 0), count, 2, 2);
+    valueAxis->coordsToPixels(keyValues+1, out+(swap ? 0 : 1), count, 2, 2);
+  }
+}
+
 /*!
   Convenience function for transforming a x/y pixel pair on the QCustomPlot surface to plot coordinates,
   taking the orientations of the axes associated with this plottable into account (e.g. whether key
@@ -13486,6 +13682,17 @@ QCP::Interaction QCPAbstractItem::selectionCategory() const
   \see replot, beforeReplot, afterLayout
 */
 
+/*! \fn void QCustomPlot::afterRasterization()
+  
+  This signal is emitted once the layers drawn by a replot are in the paint buffers, so the next
+  repaint of the widget shows them. Without the plotting hint \ref QCP::phAsyncRasterization, this
+  is immediately before \ref afterReplot. With it, layers rasterized in the background are only
+  ready later, when this signal is emitted from the event loop. Replots that were superseded by a
+  newer one before their rasterization started don't emit it.
+  
+  \see replot, afterReplot
+*/
+
 /* end of documentation of signals */
 /* start of documentation of public members */
 
@@ -13587,6 +13794,66 @@ QCP::Interaction QCPAbstractItem::selectionCategory() const
 
 /* end of documentation of public members */
 
+/*! \internal
+  \brief Layers of a replot rasterized in the background, see \ref QCP::phAsyncRasterization
+
+  \ref QCustomPlot::replot records the layers as QPictures on the GUI thread. The job replays them
+  into QImages on a thread of the global QThreadPool (painting on QImages and replaying QPictures
+  is thread-safe), then calls \ref QCustomPlot::finishRasterization from the event loop of the GUI
+  thread, which copies the images into the paint buffers of the layers.
+*/
+class QCPRasterJob : public QRunnable
+{
+public:
+  struct Layer
+  {
+    QWeakPointer<QCPAbstractPaintBuffer> paintBuffer;
+    QSize size;
+    double devicePixelRatio;
+    QPicture picture;
+    QImage image;
+  };
+  
+  explicit QCPRasterJob(QCustomPlot *parentPlot) :
+    mParentPlot(parentPlot)
+  {
+    setAutoDelete(false);
+  }
+  
+  QVector<Layer> &layers() { return mLayers; }
+  
+  // waits until run has returned
+  void wait()
+  {
+    mDone.acquire();
+    mDone.release();
+  }
+  
+  virtual void run() Q_DECL_OVERRIDE
+  {
+    for (int i=0; i<mLayers.size(); ++i)
+    {
+      Layer &layer = mLayers[i];
+#ifdef QCP_DEVICEPIXELRATIO_SUPPORTED
+      layer.image = QImage(layer.size*layer.devicePixelRatio, QImage::Format_ARGB32_Premultiplied);
+      layer.image.setDevicePixelRatio(layer.devicePixelRatio);
+#else
+      layer.image = QImage(layer.size, QImage::Format_ARGB32_Premultiplied);
+#endif
+      layer.image.fill(Qt::transparent);
+      QPainter painter(&layer.image);
+      painter.drawPicture(0, 0, layer.picture);
+    }
+    QMetaObject::invokeMethod(mParentPlot, "finishRasterization", Qt::QueuedConnection);
+    mDone.release();
+  }
+  
+private:
+  QCustomPlot *mParentPlot;
+  QVector<Layer> mLayers;
+  QSemaphore mDone;
+};
+
 /*!
   Constructs a QCustomPlot and sets reasonable default values.
 */
@@ -13621,6 +13888,8 @@ QCustomPlot::QCustomPlot(QWidget *parent) :
   mReplotQueued(false),
   mReplotTime(0),
   mReplotTimeAverage(0),
+  mRasterJob(nullptr),
+  mPendingRasterJob(nullptr),
   mOpenGlMultisamples(16),
   mOpenGlAntialiasedElementsBackup(QCP::aeNone),
   mOpenGlCacheLabelsBackup(true)
@@ -13691,6 +13960,15 @@ QCustomPlot::QCustomPlot(QWidget *parent) :
 
 QCustomPlot::~QCustomPlot()
 {
+  // the background rasterization must be over before its paint buffers go away:
+  if (mRasterJob)
+  {
+    if (!QThreadPool::globalInstance()->tryTake(mRasterJob))
+      mRasterJob->wait();
+    delete mRasterJob;
+  }
+  delete mPendingRasterJob;
+  
   clearPlottables();
   clearItems();
 
@@ -15110,6 +15388,10 @@ void QCustomPlot::deselectAll()
   replot only that specific layer via \ref QCPLayer::replot. See the documentation there for
   details.
   
+  With the plotting hint \ref QCP::phAsyncRasterization, buffered layers holding only plottables are
+  recorded and rasterized on a background thread: they are only updated on screen when \ref
+  afterRasterization is emitted, and \ref replotTime doesn't include their rasterization.
+  
   \see replotTime
 */
 void QCustomPlot::replot(QCustomPlot::RefreshPriority refreshPriority)
@@ -15139,12 +15421,38 @@ void QCustomPlot::replot(QCustomPlot::RefreshPriority refreshPriority)
 # endif
   
   updateLayout();
-  // draw all layered objects (grid, axes, plottables, items, legend,...) into their buffers:
+  // compute the geometry of the plottables concurrently, then draw all layered objects (grid, axes, plottables, items, legend,...) into their buffers:
+  QList<QCPAbstractPlottable*> preparedPlottables;
+  preparePlottables(preparedPlottables);
   setupPaintBuffers();
+  QCPRasterJob *rasterJob = nullptr;
   foreach (QCPLayer *layer, mLayers)
-    layer->drawToPaintBuffer();
+  {
+    if (rasterizesAsync(layer))
+    {
+      // record the layer, to be rasterized in the background:
+      if (!rasterJob)
+        rasterJob = new QCPRasterJob(this);
+      QCPRasterJob::Layer rasterLayer;
+      rasterLayer.paintBuffer = layer->mPaintBuffer;
+      rasterLayer.size = viewport().size();
+      rasterLayer.devicePixelRatio = mBufferDevicePixelRatio;
+      QCPPainter painter(&rasterLayer.picture);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+      painter.setRenderHint(QPainter::HighQualityAntialiasing); // as QCPPaintBufferPixmap::startPainting
+#endif
+      layer->draw(&painter);
+      painter.end();
+      rasterJob->layers().append(rasterLayer);
+    } else
+      layer->drawToPaintBuffer();
+  }
+  foreach (QCPAbstractPlottable *plottable, preparedPlottables)
+    plottable->discardGeometry();
   foreach (QSharedPointer<QCPAbstractPaintBuffer> buffer, mPaintBuffers)
     buffer->setInvalidated(false);
+  if (rasterJob)
+    startRasterization(rasterJob);
   
   if ((refreshPriority == rpRefreshHint && mPlottingHints.testFlag(QCP::phImmediateRefresh)) || refreshPriority==rpImmediateRefresh)
     repaint();
@@ -15161,6 +15469,8 @@ void QCustomPlot::replot(QCustomPlot::RefreshPriority refreshPriority)
   else
     mReplotTimeAverage = mReplotTime; // no previous replots to average with, so initialize with replot time
   
+  if (!rasterJob)
+    emit afterRasterization();
   emit afterReplot();
   mReplotting = false;
 }
@@ -15759,6 +16069,168 @@ void QCustomPlot::updateLayout()
   emit afterLayout();
 }
 
+/*! \internal
+  \brief The geometry preparation of a plottable, run in a QThreadPool
+
+  See \ref QCustomPlot::preparePlottables.
+*/
+class QCPPlottablePreparationTask : public QRunnable
+{
+public:
+  QCPPlottablePreparationTask(QCPAbstractPlottable *plottable, QSemaphore *done) :
+    mPlottable(plottable), mDone(done)
+  {
+    setAutoDelete(false);
+  }
+  
+  virtual void run() Q_DECL_OVERRIDE
+  {
+    mPlottable->prepareGeometry();
+    mDone->release();
+  }
+  
+private:
+  QCPAbstractPlottable *mPlottable;
+  QSemaphore *mDone;
+};
+
+/*! \internal
+
+  First phase of \ref replot: lets all visible plottables compute the pixel geometry they draw
+  (see \ref QCPAbstractPlottable::prepareGeometry) concurrently, so that drawing the layers only
+  paints it. With many graphs, the replot then takes about as long as preparing the slowest one.
+
+  The plottables are prepared on threads of the global QThreadPool, except the first one which
+  the calling thread prepares, before running the preparations no thread of the pool has started
+  yet. The plottables prepared are returned in \a prepared, so their geometry can be discarded
+  after drawing (see \ref QCPAbstractPlottable::discardGeometry). With a single visible plottable,
+  nothing is prepared and it computes its geometry when drawn, as usual.
+*/
+void QCustomPlot::preparePlottables(QList<QCPAbstractPlottable*> &prepared)
+{
+  prepared.clear();
+  QThreadPool *pool = QThreadPool::globalInstance();
+  if (pool->maxThreadCount() < 2)
+    return;
+  foreach (QCPAbstractPlottable *plottable, mPlottables)
+  {
+    if (plottable->realVisibility())
+      prepared.append(plottable);
+  }
+  if (prepared.size() < 2)
+  {
+    prepared.clear();
+    return;
+  }
+  
+  QSemaphore done;
+  QVector<QCPPlottablePreparationTask*> tasks;
+  for (int i=1; i<prepared.size(); ++i)
+  {
+    tasks << new QCPPlottablePreparationTask(prepared.at(i), &done);
+    pool->start(tasks.last());
+  }
+  prepared.first()->prepareGeometry();
+  foreach (QCPPlottablePreparationTask *task, tasks)
+  {
+    if (pool->tryTake(task))
+      task->run();
+  }
+  done.acquire(tasks.size());
+  qDeleteAll(tasks);
+}
+
+/*! \internal
+
+  Returns whether \a layer is rasterized in the background by \ref replot: the plotting hint \ref
+  QCP::phAsyncRasterization is set, OpenGL is off, and \a layer is a visible buffered layer (\ref
+  QCPLayer::lmBuffered) holding only plottables. These draw from their data and pixel geometry
+  only, so their recording doesn't depend on the paint device (unlike text, whose size depends on
+  its resolution).
+*/
+bool QCustomPlot::rasterizesAsync(QCPLayer *layer) const
+{
+  if (!mPlottingHints.testFlag(QCP::phAsyncRasterization) || mOpenGl)
+    return false;
+  if (layer->mode() != QCPLayer::lmBuffered || !layer->visible() || layer->children().isEmpty())
+    return false;
+  foreach (QCPLayerable *child, layer->children())
+  {
+    if (!qobject_cast<QCPAbstractPlottable*>(child))
+      return false;
+  }
+  return true;
+}
+
+/*! \internal
+
+  Rasterizes the layers recorded in \a job in the background, taking ownership of it. If a
+  rasterization is still running, \a job waits until it is finished, replacing the job that was
+  waiting already (that frame is dropped).
+
+  \see finishRasterization
+*/
+void QCustomPlot::startRasterization(QCPRasterJob *job)
+{
+  if (mRasterJob)
+  {
+    delete mPendingRasterJob;
+    mPendingRasterJob = job;
+  } else
+  {
+    mRasterJob = job;
+    QThreadPool::globalInstance()->start(mRasterJob);
+  }
+}
+
+/*! \internal
+
+  Called from the event loop when the background rasterization is finished. Copies the images of
+  the layers into their paint buffers (unless they were resized in the meantime, the next frame
+  being on its way), starts the rasterization of the next frame if one is waiting, refreshes the
+  widget and emits \ref afterRasterization.
+*/
+void QCustomPlot::finishRasterization()
+{
+  QCPRasterJob *job = mRasterJob;
+  if (!job)
+    return;
+  job->wait();
+  mRasterJob = nullptr;
+  
+  if (mPlottingHints.testFlag(QCP::phAsyncRasterization))
+  {
+    foreach (const QCPRasterJob::Layer &layer, job->layers())
+    {
+      QSharedPointer<QCPAbstractPaintBuffer> buffer = layer.paintBuffer.toStrongRef();
+      if (buffer && buffer->size() == layer.size && qFuzzyCompare(buffer->devicePixelRatio(), layer.devicePixelRatio))
+      {
+        buffer->clear(Qt::transparent);
+        if (QCPPainter *painter = buffer->startPainting())
+        {
+          painter->drawImage(0, 0, layer.image);
+          delete painter;
+        }
+        buffer->donePainting();
+      }
+    }
+  }
+  delete job;
+  
+  if (mPendingRasterJob)
+  {
+    mRasterJob = mPendingRasterJob;
+    mPendingRasterJob = nullptr;
+    QThreadPool::globalInstance()->start(mRasterJob);
+  }
+  
+  if (mPlottingHints.testFlag(QCP::phImmediateRefresh))
+    repaint();
+  else
+    update();
+  emit afterRasterization();
+}
+
 /*! \internal
   
   Draws the viewport background pixmap of the plot.
@@ -15846,11 +16318,19 @@ void QCustomPlot::setupPaintBuffers()
   // remove unneeded buffers:
   while (mPaintBuffers.size()-1 > bufferIndex)
     mPaintBuffers.removeLast();
+  // buffers of layers rasterized in the background keep showing the previous frame until the new one is ready:
+  QList<QCPAbstractPaintBuffer*> keptBuffers;
+  foreach (QCPLayer *layer, mLayers)
+  {
+    if (rasterizesAsync(layer))
+      keptBuffers.append(layer->mPaintBuffer.toStrongRef().data());
+  }
   // resize buffers to viewport size and clear contents:
   foreach (QSharedPointer<QCPAbstractPaintBuffer> buffer, mPaintBuffers)
   {
     buffer->setSize(viewport().size()); // won't do anything if already correct size
-    buffer->clear(Qt::transparent);
+    if (!keptBuffers.contains(buffer.data()))
+      buffer->clear(Qt::transparent);
     buffer->setInvalidated();
   }
 }
@@ -20793,82 +21273,317 @@ QCPGraphData::QCPGraphData(double key, double value) :
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-//////////////////// QCPGraph
+//////////////////// QCPGraphLodPyramid
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-/*! \class QCPGraph
-  \brief A plottable representing a graph in a plot.
+/*! \class QCPGraphLodPyramid
+  \brief A multi-resolution summary of the values in a QCPGraphDataContainer
 
-  \image html QCPGraph.png
-  
-  Usually you create new graphs by calling QCustomPlot::addGraph. The resulting instance can be
-  accessed via QCustomPlot::graph.
+  The pyramid holds, for every bucket of 2^k consecutive data points (k from \ref BaseLevelShift
+  up), the minimum and maximum value and where they are. Each level is built from pairs of
+  buckets of the next finer one, so it takes about a fifth of the memory of the data itself.
 
-  To plot data, assign it with the \ref setData or \ref addData functions. Alternatively, you can
-  also access and modify the data via the \ref data method, which returns a pointer to the internal
-  \ref QCPGraphDataContainer.
-  
-  Graphs are used to display single-valued data. Single-valued means that there should only be one
-  data point per unique key coordinate. In other words, the graph can't have \a loops. If you do
-  want to plot non-single-valued curves, rather use the QCPCurve plottable.
-  
-  Gaps in the graph line can be created by adding data points with NaN as value
-  (<tt>qQNaN()</tt> or <tt>std::numeric_limits<double>::quiet_NaN()</tt>) in between the two data points that shall be
-  separated.
-  
-  \section qcpgraph-appearance Changing the appearance
-  
-  The appearance of the graph is mainly determined by the line style, scatter style, brush and pen
-  of the graph (\ref setLineStyle, \ref setScatterStyle, \ref setBrush, \ref setPen).
-  
-  \subsection filling Filling under or between graphs
-  
-  QCPGraph knows two types of fills: Normal graph fills towards the zero-value-line parallel to
-  the key axis of the graph, and fills between two graphs, called channel fills. To enable a fill,
-  just set a brush with \ref setBrush which is neither Qt::NoBrush nor fully transparent.
-  
-  By default, a normal fill towards the zero-value-line will be drawn. To set up a channel fill
-  between this graph and another one, call \ref setChannelFillGraph with the other graph as
-  parameter.
+  QCPGraph uses it for adaptive sampling when many data points fall on each pixel: instead of
+  visiting every data point in the visible range, it walks the buckets of the coarsest level that
+  still has at least one bucket per pixel (see \ref levelFor and \ref nextSpan), so the cost of a
+  replot depends on the width of the plot rather than on the number of data points.
 
-  \see QCustomPlot::addGraph, QCustomPlot::graph
+  The pyramid is brought up to date with \ref update before it is used. Buckets are aligned to
+  the position of data points since the last change of \ref QCPDataContainer::revision (see \ref
+  QCPDataContainer::frontOffset), so data points appended to the container are summarized
+  incrementally, and data points removed from its front just discard the buckets that held them.
+  Any other modification of the container causes a complete rebuild.
 */
 
-/* start of documentation of inline functions */
-
-/*! \fn QSharedPointer<QCPGraphDataContainer> QCPGraph::data() const
-  
-  Returns a shared pointer to the internal data storage of type \ref QCPGraphDataContainer. You may
-  use it to directly manipulate the data, which may be more convenient and faster than using the
-  regular \ref setData or \ref addData methods.
+/*!
+  Constructs an empty pyramid.
 */
-
-/* end of documentation of inline functions */
+QCPGraphLodPyramid::QCPGraphLodPyramid() :
+  mSource(nullptr),
+  mRevision(0),
+  mFrontOffset(0),
+  mSummarized(0)
+{
+}
 
 /*!
-  Constructs a graph which uses \a keyAxis as its key axis ("x") and \a valueAxis as its value
-  axis ("y"). \a keyAxis and \a valueAxis must reside in the same QCustomPlot instance and not have
-  the same orientation. If either of these restrictions is violated, a corresponding message is
-  printed to the debug output (qDebug), the construction is not aborted, though.
-  
-  The created QCPGraph is automatically registered with the QCustomPlot instance inferred from \a
-  keyAxis. This QCustomPlot instance takes ownership of the QCPGraph, so do not delete it manually
-  but use QCustomPlot::removePlottable() instead.
-  
-  To directly create a graph inside a plot, you can also use the simpler QCustomPlot::addGraph function.
+  Discards all buckets. The next \ref update rebuilds the pyramid.
 */
-QCPGraph::QCPGraph(QCPAxis *keyAxis, QCPAxis *valueAxis) :
-  QCPAbstractPlottable1D<QCPGraphData>(keyAxis, valueAxis),
-  mLineStyle{},
-  mScatterSkip{},
-  mAdaptiveSampling{}
+void QCPGraphLodPyramid::clear()
 {
-  // special handling for QCPGraphs to maintain the simple graph interface:
-  mParentPlot->registerGraph(this);
+  mSource = nullptr;
+  mLevels.clear();
+  mStart.clear();
+  mFirst.clear();
+  mFrontOffset = 0;
+  mSummarized = 0;
+}
 
-  setPen(QPen(Qt::blue, 0));
-  setBrush(Qt::NoBrush);
-  
+/*!
+  Brings the pyramid up to date with \a data. Only the data points appended since the last call
+  are summarized, unless \a data is a different container or its revision changed, in which case
+  the pyramid is rebuilt.
+*/
+void QCPGraphLodPyramid::update(const QCPGraphDataContainer &data)
+{
+  const qint64 baseSize = qint64(1) << BaseLevelShift;
+  const qint64 dataEnd = data.frontOffset()+data.size();
+  if (mSource != &data || mRevision != data.revision() || dataEnd < mSummarized)
+  {
+    clear();
+    mSource = &data;
+    mRevision = data.revision();
+  }
+  mFrontOffset = data.frontOffset();
+  
+  // discard the buckets whose data points were all removed from the front of the container:
+  for (int level=0; level<mLevels.size(); ++level)
+  {
+    const int shift = BaseLevelShift+level;
+    const qint64 live = mLevels.at(level).size()-mStart.at(level);
+    const qint64 removed = qBound(qint64(0), (mFrontOffset>>shift)-mFirst.at(level), live);
+    mStart[level] += int(removed);
+    mFirst[level] += removed;
+    if (mStart.at(level) > 1024 && mStart.at(level) > mLevels.at(level).size()/2) // reclaim the storage of discarded buckets once in a while
+    {
+      mLevels[level].remove(0, mStart.at(level));
+      mStart[level] = 0;
+    }
+  }
+  
+  // summarize the complete buckets of appended data points in the finest level:
+  if (mSummarized < mFrontOffset) // data points were removed before they were summarized
+    mSummarized = (mFrontOffset+baseSize-1)/baseSize*baseSize;
+  if (mSummarized+baseSize > dataEnd)
+    return;
+  if (mLevels.isEmpty())
+  {
+    mLevels.append(QVector<Bucket>());
+    mStart.append(0);
+    mFirst.append(mSummarized>>BaseLevelShift);
+  } else if (mStart.at(0) == mLevels.at(0).size())
+    mFirst[0] = mSummarized>>BaseLevelShift;
+  mLevels[0].reserve(mLevels.at(0).size()+int((dataEnd-mSummarized)>>BaseLevelShift));
+  while (mSummarized+baseSize <= dataEnd)
+  {
+    QCPGraphDataContainer::const_iterator it = data.constBegin()+int(mSummarized-mFrontOffset);
+    Bucket bucket = {it->value, it->value, 0, 0};
+    for (quint32 i=1; i<quint32(baseSize); ++i)
+    {
+      const double value = (it+i)->value;
+      if (value < bucket.minValue || qIsNaN(bucket.minValue))
+      {
+        bucket.minValue = value;
+        bucket.minOffset = i;
+      }
+      if (value > bucket.maxValue || qIsNaN(bucket.maxValue))
+      {
+        bucket.maxValue = value;
+        bucket.maxOffset = i;
+      }
+    }
+    mLevels[0].append(bucket);
+    mSummarized += baseSize;
+  }
+  
+  // coarser levels, from the pairs of buckets of the next finer level:
+  for (int level=1; level<62-BaseLevelShift; ++level)
+  {
+    const int finer = level-1;
+    const qint64 finerEnd = mFirst.at(finer)+mLevels.at(finer).size()-mStart.at(finer);
+    const qint64 firstPair = (mFirst.at(finer)+1)/2;
+    if (level == mLevels.size())
+    {
+      if (2*firstPair+1 >= finerEnd) // no complete pair yet
+        break;
+      mLevels.append(QVector<Bucket>());
+      mStart.append(0);
+      mFirst.append(firstPair);
+    }
+    qint64 next = mFirst.at(level)+mLevels.at(level).size()-mStart.at(level);
+    if (2*next < mFirst.at(finer)) // the finer buckets were removed before being paired, so this level is empty too
+    {
+      next = firstPair;
+      mFirst[level] = next;
+    }
+    const quint32 finerSize = quint32(1) << (BaseLevelShift+finer);
+    while (2*next+1 < finerEnd)
+    {
+      const QVector<Bucket> &finerLevel = mLevels.at(finer);
+      const int i = mStart.at(finer)+int(2*next-mFirst.at(finer));
+      mLevels[level].append(merge(finerLevel.at(i), finerLevel.at(i+1), finerSize));
+      ++next;
+    }
+  }
+}
+
+/*!
+  Returns the coarsest level whose buckets hold at most \a pointsPerPixel data points, or -1 if
+  even the buckets of the finest level are larger (in which case visiting the data points
+  directly is cheap enough).
+*/
+int QCPGraphLodPyramid::levelFor(double pointsPerPixel) const
+{
+  int level = -1;
+  while (level+1 < mLevels.size() && double(qint64(1) << (BaseLevelShift+level+1)) <= pointsPerPixel)
+    ++level;
+  return level;
+}
+
+/*!
+  Returns via \a span the summary of the data points of \a data from \a index on, and returns the
+  index of the first data point after them. This is the largest bucket (of \a maxLevel at most)
+  that starts at \a index and ends before \a end, or the single data point at \a index if there is
+  none, so walking a range with this method visits O(number of buckets of \a maxLevel in range +
+  log(range size)) spans.
+
+  \ref update must have been called with \a data beforehand.
+*/
+int QCPGraphLodPyramid::nextSpan(const QCPGraphDataContainer &data, int index, int end, int maxLevel, Span &span) const
+{
+  const qint64 position = mFrontOffset+index;
+  for (int level=qMin(maxLevel, mLevels.size()-1); level>=0; --level)
+  {
+    const int shift = BaseLevelShift+level;
+    const int size = 1 << shift;
+    if ((position & (size-1)) != 0 || end-index < size)
+      continue;
+    if (const Bucket *bucket = this->bucket(level, position>>shift))
+    {
+      span.begin = index;
+      span.count = size;
+      span.minValue = bucket->minValue;
+      span.maxValue = bucket->maxValue;
+      span.minIndex = index+int(bucket->minOffset);
+      span.maxIndex = index+int(bucket->maxOffset);
+      return index+size;
+    }
+  }
+  const double value = (data.constBegin()+index)->value;
+  span.begin = index;
+  span.count = 1;
+  span.minValue = value;
+  span.maxValue = value;
+  span.minIndex = index;
+  span.maxIndex = index;
+  return index+1;
+}
+
+/*! \internal
+
+  Returns the bucket that summarizes the buckets \a a and \a b, where \a b starts \a bOffset data
+  points after \a a. NaN values are ignored unless both buckets only hold NaN values.
+*/
+QCPGraphLodPyramid::Bucket QCPGraphLodPyramid::merge(const Bucket &a, const Bucket &b, quint32 bOffset)
+{
+  Bucket result = a;
+  if (b.minValue < result.minValue || qIsNaN(result.minValue))
+  {
+    result.minValue = b.minValue;
+    result.minOffset = b.minOffset+bOffset;
+  }
+  if (b.maxValue > result.maxValue || qIsNaN(result.maxValue))
+  {
+    result.maxValue = b.maxValue;
+    result.maxOffset = b.maxOffset+bOffset;
+  }
+  return result;
+}
+
+/*! \internal
+
+  Returns the bucket of \a level at \a position (in buckets of that level), or nullptr if it
+  wasn't built yet or some of its data points were removed.
+*/
+const QCPGraphLodPyramid::Bucket *QCPGraphLodPyramid::bucket(int level, qint64 position) const
+{
+  if (level < 0 || level >= mLevels.size())
+    return nullptr;
+  const qint64 offset = position-mFirst.at(level);
+  if (offset < 0 || offset >= mLevels.at(level).size()-mStart.at(level) || (position << (BaseLevelShift+level)) < mFrontOffset)
+    return nullptr;
+  return &mLevels.at(level).at(mStart.at(level)+int(offset));
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPGraph
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPGraph
+  \brief A plottable representing a graph in a plot.
+
+  \image html QCPGraph.png
+  
+  Usually you create new graphs by calling QCustomPlot::addGraph. The resulting instance can be
+  accessed via QCustomPlot::graph.
+
+  To plot data, assign it with the \ref setData or \ref addData functions. Alternatively, you can
+  also access and modify the data via the \ref data method, which returns a pointer to the internal
+  \ref QCPGraphDataContainer.
+  
+  Graphs are used to display single-valued data. Single-valued means that there should only be one
+  data point per unique key coordinate. In other words, the graph can't have \a loops. If you do
+  want to plot non-single-valued curves, rather use the QCPCurve plottable.
+  
+  Gaps in the graph line can be created by adding data points with NaN as value
+  (<tt>qQNaN()</tt> or <tt>std::numeric_limits<double>::quiet_NaN()</tt>) in between the two data points that shall be
+  separated.
+  
+  \section qcpgraph-appearance Changing the appearance
+  
+  The appearance of the graph is mainly determined by the line style, scatter style, brush and pen
+  of the graph (\ref setLineStyle, \ref setScatterStyle, \ref setBrush, \ref setPen).
+  
+  \subsection filling Filling under or between graphs
+  
+  QCPGraph knows two types of fills: Normal graph fills towards the zero-value-line parallel to
+  the key axis of the graph, and fills between two graphs, called channel fills. To enable a fill,
+  just set a brush with \ref setBrush which is neither Qt::NoBrush nor fully transparent.
+  
+  By default, a normal fill towards the zero-value-line will be drawn. To set up a channel fill
+  between this graph and another one, call \ref setChannelFillGraph with the other graph as
+  parameter.
+
+  \see QCustomPlot::addGraph, QCustomPlot::graph
+*/
+
+/* start of documentation of inline functions */
+
+/*! \fn QSharedPointer<QCPGraphDataContainer> QCPGraph::data() const
+  
+  Returns a shared pointer to the internal data storage of type \ref QCPGraphDataContainer. You may
+  use it to directly manipulate the data, which may be more convenient and faster than using the
+  regular \ref setData or \ref addData methods.
+*/
+
+/* end of documentation of inline functions */
+
+/*!
+  Constructs a graph which uses \a keyAxis as its key axis ("x") and \a valueAxis as its value
+  axis ("y"). \a keyAxis and \a valueAxis must reside in the same QCustomPlot instance and not have
+  the same orientation. If either of these restrictions is violated, a corresponding message is
+  printed to the debug output (qDebug), the construction is not aborted, though.
+  
+  The created QCPGraph is automatically registered with the QCustomPlot instance inferred from \a
+  keyAxis. This QCustomPlot instance takes ownership of the QCPGraph, so do not delete it manually
+  but use QCustomPlot::removePlottable() instead.
+  
+  To directly create a graph inside a plot, you can also use the simpler QCustomPlot::addGraph function.
+*/
+QCPGraph::QCPGraph(QCPAxis *keyAxis, QCPAxis *valueAxis) :
+  QCPAbstractPlottable1D<QCPGraphData>(keyAxis, valueAxis),
+  mLineStyle{},
+  mScatterSkip{},
+  mAdaptiveSampling{},
+  mGeometryPrepared(false)
+{
+  // special handling for QCPGraphs to maintain the simple graph interface:
+  mParentPlot->registerGraph(this);
+
+  setPen(QPen(Qt::blue, 0));
+  setBrush(Qt::NoBrush);
+  
   setLineStyle(lsLine);
   setScatterSkip(0);
   setChannelFillGraph(nullptr);
@@ -20998,6 +21713,11 @@ void QCPGraph::setChannelFillGraph(QCPGraph *targetGraph)
   reproduced reliably, as well as the overall shape of the data set. The replot time reduces
   dramatically though. This allows QCustomPlot to display large amounts of data in realtime.
   
+  When many data points fall on each pixel of a linear key axis, adaptive sampling uses a
+  level-of-detail pyramid of the data (see \ref QCPGraphLodPyramid) instead of visiting every
+  visible data point, so the replot time depends on the width of the plot rather than on the number
+  of data points. The pyramid is kept up to date incrementally while data is appended to the graph.
+  
   \image html adaptive-sampling-scatter.png "A scatter plot of 100,000 points without and with adaptive sampling"
   
   Care must be taken when using high-density scatter plots in combination with adaptive sampling.
@@ -21110,28 +21830,29 @@ void QCPGraph::draw(QCPPainter *painter)
   if (mKeyAxis.data()->range().size() <= 0 || mDataContainer->isEmpty()) return;
   if (mLineStyle == lsNone && mScatterStyle.isNone()) return;
   
-  QVector<QPointF> lines, scatters; // line and (if necessary) scatter pixel coordinates will be stored here while iterating over segments
+  // line, fill and scatter pixel coordinates of the segments, unless QCustomPlot::replot already prepared them:
+  QVector<SegmentGeometry> geometry;
+  if (mGeometryPrepared)
+    geometry.swap(mGeometry);
+  else
+    getSegmentGeometry(&geometry);
+  mGeometryPrepared = false;
   
-  // loop over and draw segments of unselected/selected data:
-  QList<QCPDataRange> selectedSegments, unselectedSegments, allSegments;
-  getDataSegments(selectedSegments, unselectedSegments);
-  allSegments << unselectedSegments << selectedSegments;
-  for (int i=0; i<allSegments.size(); ++i)
-  {
-    bool isSelectedSegment = i >= unselectedSegments.size();
-    // get line pixel points appropriate to line style:
-    QCPDataRange lineDataRange = isSelectedSegment ? allSegments.at(i) : allSegments.at(i).adjusted(-1, 1); // unselected segments extend lines to bordering selected data point (safe to exceed total data bounds in first/last segment, getLines takes care)
-    getLines(&lines, lineDataRange);
-    
-    // check data validity if flag set:
+  // check data validity if flag set:
 #ifdef QCUSTOMPLOT_CHECK_DATA
-    QCPGraphDataContainer::const_iterator it;
-    for (it = mDataContainer->constBegin(); it != mDataContainer->constEnd(); ++it)
-    {
-      if (QCP::isInvalidData(it->key, it->value))
-        qDebug() << Q_FUNC_INFO << "Data point at" << it->key << "invalid." << "Plottable name:" << name();
-    }
+  QCPGraphDataContainer::const_iterator it;
+  for (it = mDataContainer->constBegin(); it != mDataContainer->constEnd(); ++it)
+  {
+    if (QCP::isInvalidData(it->key, it->value))
+      qDebug() << Q_FUNC_INFO << "Data point at" << it->key << "invalid." << "Plottable name:" << name();
+  }
 #endif
+  
+  // loop over and draw segments of unselected/selected data:
+  for (int i=0; i<geometry.size(); ++i)
+  {
+    SegmentGeometry &segment = geometry[i];
+    bool isSelectedSegment = segment.selected;
     
     // draw fill of graph:
     if (isSelectedSegment && mSelectionDecorator)
@@ -21139,7 +21860,7 @@ void QCPGraph::draw(QCPPainter *painter)
     else
       painter->setBrush(mBrush);
     painter->setPen(Qt::NoPen);
-    drawFill(painter, &lines);
+    drawFill(painter, &segment.lines, &segment.fillPolygons);
     
     // draw line:
     if (mLineStyle != lsNone)
@@ -21150,9 +21871,9 @@ void QCPGraph::draw(QCPPainter *painter)
         painter->setPen(mPen);
       painter->setBrush(Qt::NoBrush);
       if (mLineStyle == lsImpulse)
-        drawImpulsePlot(painter, lines);
+        drawImpulsePlot(painter, segment.lines);
       else
-        drawLinePlot(painter, lines); // also step plots can be drawn as a line plot
+        drawLinePlot(painter, segment.lines); // also step plots can be drawn as a line plot
     }
     
     // draw scatters:
@@ -21160,10 +21881,7 @@ void QCPGraph::draw(QCPPainter *painter)
     if (isSelectedSegment && mSelectionDecorator)
       finalScatterStyle = mSelectionDecorator->getFinalScatterStyle(mScatterStyle);
     if (!finalScatterStyle.isNone())
-    {
-      getScatters(&scatters, allSegments.at(i));
-      drawScatterPlot(painter, scatters, finalScatterStyle);
-    }
+      drawScatterPlot(painter, segment.scatters, finalScatterStyle);
   }
   
   // draw other selection decoration that isn't just line/scatter pens and brushes:
@@ -21206,6 +21924,80 @@ void QCPGraph::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const
   }
 }
 
+/*! \internal
+
+  Computes the pixel geometry of the graph (see \ref getSegmentGeometry) ahead of the next \ref
+  draw call, which then only paints it. This is called by \ref QCustomPlot::replot for all
+  visible plottables concurrently, on threads of the global QThreadPool: it only reads the data,
+  the axes and the properties of this graph, besides the level-of-detail pyramid which only this
+  graph uses.
+
+  \see discardGeometry
+*/
+void QCPGraph::prepareGeometry()
+{
+  mGeometryPrepared = false;
+  if (!mKeyAxis || !mValueAxis) return;
+  if (mKeyAxis.data()->range().size() <= 0 || mDataContainer->isEmpty()) return;
+  if (mLineStyle == lsNone && mScatterStyle.isNone()) return;
+  
+  getSegmentGeometry(&mGeometry);
+  mGeometryPrepared = true;
+}
+
+/*! \internal
+
+  Releases the geometry computed by \ref prepareGeometry if it wasn't drawn, so that a later \ref
+  draw (e.g. when exporting the plot with another size) computes it again.
+*/
+void QCPGraph::discardGeometry()
+{
+  mGeometry.clear();
+  mGeometryPrepared = false;
+}
+
+/*! \internal
+
+  Computes in \a geometry the pixel coordinates of the line (see \ref getLines), fill polygons
+  (see \ref getFillPolygons) and scatters (see \ref getScatters) of every segment of unselected
+  and selected data (see \ref getDataSegments), in the order they are drawn.
+
+  Fill polygons are only computed when the brush of the segment is visible and the graph doesn't
+  have a channel fill graph, whose line \ref drawFill gets when drawing. Scatters of selected
+  segments are computed whenever there is a selection decorator, since its final scatter style is
+  only known when drawing.
+*/
+void QCPGraph::getSegmentGeometry(QVector<SegmentGeometry> *geometry) const
+{
+  QList<QCPDataRange> selectedSegments, unselectedSegments, allSegments;
+  getDataSegments(selectedSegments, unselectedSegments);
+  allSegments << unselectedSegments << selectedSegments;
+  geometry->resize(allSegments.size());
+  for (int i=0; i<allSegments.size(); ++i)
+  {
+    SegmentGeometry &segment = (*geometry)[i];
+    segment.dataRange = allSegments.at(i);
+    segment.selected = i >= unselectedSegments.size();
+    // get line pixel points appropriate to line style:
+    QCPDataRange lineDataRange = segment.selected ? segment.dataRange : segment.dataRange.adjusted(-1, 1); // unselected segments extend lines to bordering selected data point (safe to exceed total data bounds in first/last segment, getLines takes care)
+    getLines(&segment.lines, lineDataRange);
+    
+    const QBrush brush = segment.selected && mSelectionDecorator ? mSelectionDecorator->brush() : mBrush;
+    if (mLineStyle != lsImpulse && !mChannelFillGraph && brush.style() != Qt::NoBrush && brush.color().alpha() != 0)
+      segment.fillPolygons = getFillPolygons(&segment.lines);
+    else
+      segment.fillPolygons.clear();
+    
+    if (!mScatterStyle.isNone() || (segment.selected && mSelectionDecorator))
+      getScatters(&segment.scatters, segment.dataRange);
+    else
+      segment.scatters.clear();
+  }
+}
+
+// vectors of QCPGraphData are transformed to pixels as arrays of key/value pairs
+Q_STATIC_ASSERT(sizeof(QCPGraphData) == 2*sizeof(double));
+
 /*! \internal
 
   This method retrieves an optimized set of data points via \ref getOptimizedLineData, and branches
@@ -21289,26 +22081,11 @@ void QCPGraph::getScatters(QVector<QPointF> *scatters, const QCPDataRange &dataR
     std::reverse(data.begin(), data.end());
   
   scatters->resize(data.size());
-  if (keyAxis->orientation() == Qt::Vertical)
-  {
-    for (int i=0; i<data.size(); ++i)
-    {
-      if (!qIsNaN(data.at(i).value))
-      {
-        (*scatters)[i].setX(valueAxis->coordToPixel(data.at(i).value));
-        (*scatters)[i].setY(keyAxis->coordToPixel(data.at(i).key));
-      }
-    }
-  } else
+  coordsToPixels(reinterpret_cast<const double*>(data.constData()), scatters->data(), data.size());
+  for (int i=0; i<data.size(); ++i)
   {
-    for (int i=0; i<data.size(); ++i)
-    {
-      if (!qIsNaN(data.at(i).value))
-      {
-        (*scatters)[i].setX(keyAxis->coordToPixel(data.at(i).key));
-        (*scatters)[i].setY(valueAxis->coordToPixel(data.at(i).value));
-      }
-    }
+    if (qIsNaN(data.at(i).value))
+      (*scatters)[i] = QPointF();
   }
 }
 
@@ -21331,22 +22108,8 @@ QVector<QPointF> QCPGraph::dataToLines(const QVector<QCPGraphData> &data) const
 
   result.resize(data.size());
   
-  // transform data points to pixels:
-  if (keyAxis->orientation() == Qt::Vertical)
-  {
-    for (int i=0; i<data.size(); ++i)
-    {
-      result[i].setX(valueAxis->coordToPixel(data.at(i).value));
-      result[i].setY(keyAxis->coordToPixel(data.at(i).key));
-    }
-  } else // key axis is horizontal
-  {
-    for (int i=0; i<data.size(); ++i)
-    {
-      result[i].setX(keyAxis->coordToPixel(data.at(i).key));
-      result[i].setY(valueAxis->coordToPixel(data.at(i).value));
-    }
-  }
+  // transform data points to pixels, all at once:
+  coordsToPixels(reinterpret_cast<const double*>(data.constData()), result.data(), data.size());
   return result;
 }
 
@@ -21368,29 +22131,37 @@ QVector<QPointF> QCPGraph::dataToStepLeftLines(const QVector<QCPGraphData> &data
   if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return result; }
   
   result.resize(data.size()*2);
+  if (data.isEmpty())
+    return result;
   
-  // calculate steps from data and transform to pixel coordinates:
+  // transform data points to pixels into the upper half of result (the steps written below only
+  // overwrite points that were already read), then calculate steps from them:
+  const int n = data.size();
+  coordsToPixels(reinterpret_cast<const double*>(data.constData()), result.data()+n, n);
+  const QPointF *points = result.constData()+n;
   if (keyAxis->orientation() == Qt::Vertical)
   {
-    double lastValue = valueAxis->coordToPixel(data.first().value);
-    for (int i=0; i<data.size(); ++i)
+    double lastValue = points[0].x();
+    for (int i=0; i<n; ++i)
     {
-      const double key = keyAxis->coordToPixel(data.at(i).key);
+      const double key = points[i].y();
+      const double value = points[i].x();
       result[i*2+0].setX(lastValue);
       result[i*2+0].setY(key);
-      lastValue = valueAxis->coordToPixel(data.at(i).value);
+      lastValue = value;
       result[i*2+1].setX(lastValue);
       result[i*2+1].setY(key);
     }
   } else // key axis is horizontal
   {
-    double lastValue = valueAxis->coordToPixel(data.first().value);
-    for (int i=0; i<data.size(); ++i)
+    double lastValue = points[0].y();
+    for (int i=0; i<n; ++i)
     {
-      const double key = keyAxis->coordToPixel(data.at(i).key);
+      const double key = points[i].x();
+      const double value = points[i].y();
       result[i*2+0].setX(key);
       result[i*2+0].setY(lastValue);
-      lastValue = valueAxis->coordToPixel(data.at(i).value);
+      lastValue = value;
       result[i*2+1].setX(key);
       result[i*2+1].setY(lastValue);
     }
@@ -21416,29 +22187,37 @@ QVector<QPointF> QCPGraph::dataToStepRightLines(const QVector<QCPGraphData> &dat
   if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return result; }
   
   result.resize(data.size()*2);
+  if (data.isEmpty())
+    return result;
   
-  // calculate steps from data and transform to pixel coordinates:
+  // transform data points to pixels into the upper half of result (the steps written below only
+  // overwrite points that were already read), then calculate steps from them:
+  const int n = data.size();
+  coordsToPixels(reinterpret_cast<const double*>(data.constData()), result.data()+n, n);
+  const QPointF *points = result.constData()+n;
   if (keyAxis->orientation() == Qt::Vertical)
   {
-    double lastKey = keyAxis->coordToPixel(data.first().key);
-    for (int i=0; i<data.size(); ++i)
+    double lastKey = points[0].y();
+    for (int i=0; i<n; ++i)
     {
-      const double value = valueAxis->coordToPixel(data.at(i).value);
+      const double key = points[i].y();
+      const double value = points[i].x();
       result[i*2+0].setX(value);
       result[i*2+0].setY(lastKey);
-      lastKey = keyAxis->coordToPixel(data.at(i).key);
+      lastKey = key;
       result[i*2+1].setX(value);
       result[i*2+1].setY(lastKey);
     }
   } else // key axis is horizontal
   {
-    double lastKey = keyAxis->coordToPixel(data.first().key);
-    for (int i=0; i<data.size(); ++i)
+    double lastKey = points[0].x();
+    for (int i=0; i<n; ++i)
     {
-      const double value = valueAxis->coordToPixel(data.at(i).value);
+      const double key = points[i].x();
+      const double value = points[i].y();
       result[i*2+0].setX(lastKey);
       result[i*2+0].setY(value);
-      lastKey = keyAxis->coordToPixel(data.at(i).key);
+      lastKey = key;
       result[i*2+1].setX(lastKey);
       result[i*2+1].setY(value);
     }
@@ -21464,44 +22243,54 @@ QVector<QPointF> QCPGraph::dataToStepCenterLines(const QVector<QCPGraphData> &da
   if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return result; }
   
   result.resize(data.size()*2);
+  if (data.isEmpty())
+    return result;
   
-  // calculate steps from data and transform to pixel coordinates:
+  // transform data points to pixels into the upper half of result (the steps written below only
+  // overwrite points that were already read), then calculate steps from them:
+  const int n = data.size();
+  coordsToPixels(reinterpret_cast<const double*>(data.constData()), result.data()+n, n);
+  const QPointF *points = result.constData()+n;
   if (keyAxis->orientation() == Qt::Vertical)
   {
-    double lastKey = keyAxis->coordToPixel(data.first().key);
-    double lastValue = valueAxis->coordToPixel(data.first().value);
+    double lastKey = points[0].y();
+    double lastValue = points[0].x();
     result[0].setX(lastValue);
     result[0].setY(lastKey);
-    for (int i=1; i<data.size(); ++i)
+    for (int i=1; i<n; ++i)
     {
-      const double key = (keyAxis->coordToPixel(data.at(i).key)+lastKey)*0.5;
+      const double pointKey = points[i].y();
+      const double pointValue = points[i].x();
+      const double key = (pointKey+lastKey)*0.5;
       result[i*2-1].setX(lastValue);
       result[i*2-1].setY(key);
-      lastValue = valueAxis->coordToPixel(data.at(i).value);
-      lastKey = keyAxis->coordToPixel(data.at(i).key);
+      lastValue = pointValue;
+      lastKey = pointKey;
       result[i*2+0].setX(lastValue);
       result[i*2+0].setY(key);
     }
-    result[data.size()*2-1].setX(lastValue);
-    result[data.size()*2-1].setY(lastKey);
+    result[n*2-1].setX(lastValue);
+    result[n*2-1].setY(lastKey);
   } else // key axis is horizontal
   {
-    double lastKey = keyAxis->coordToPixel(data.first().key);
-    double lastValue = valueAxis->coordToPixel(data.first().value);
+    double lastKey = points[0].x();
+    double lastValue = points[0].y();
     result[0].setX(lastKey);
     result[0].setY(lastValue);
-    for (int i=1; i<data.size(); ++i)
+    for (int i=1; i<n; ++i)
     {
-      const double key = (keyAxis->coordToPixel(data.at(i).key)+lastKey)*0.5;
+      const double pointKey = points[i].x();
+      const double pointValue = points[i].y();
+      const double key = (pointKey+lastKey)*0.5;
       result[i*2-1].setX(key);
       result[i*2-1].setY(lastValue);
-      lastValue = valueAxis->coordToPixel(data.at(i).value);
-      lastKey = keyAxis->coordToPixel(data.at(i).key);
+      lastValue = pointValue;
+      lastKey = pointKey;
       result[i*2+0].setX(key);
       result[i*2+0].setY(lastValue);
     }
-    result[data.size()*2-1].setX(lastKey);
-    result[data.size()*2-1].setY(lastValue);
+    result[n*2-1].setX(lastKey);
+    result[n*2-1].setY(lastValue);
   }
   return result;
 }
@@ -21524,27 +22313,36 @@ QVector<QPointF> QCPGraph::dataToImpulseLines(const QVector<QCPGraphData> &data)
   if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return result; }
   
   result.resize(data.size()*2);
+  if (data.isEmpty())
+    return result;
   
-  // transform data points to pixels:
+  // transform data points to pixels into the upper half of result (the impulses written below only
+  // overwrite points that were already read), then draw every impulse from the zero value:
+  const int n = data.size();
+  coordsToPixels(reinterpret_cast<const double*>(data.constData()), result.data()+n, n);
+  const QPointF *points = result.constData()+n;
+  const double zeroValue = valueAxis->coordToPixel(0);
   if (keyAxis->orientation() == Qt::Vertical)
   {
-    for (int i=0; i<data.size(); ++i)
+    for (int i=0; i<n; ++i)
     {
-      const double key = keyAxis->coordToPixel(data.at(i).key);
-      result[i*2+0].setX(valueAxis->coordToPixel(0));
+      const double key = points[i].y();
+      const double value = points[i].x();
+      result[i*2+0].setX(zeroValue);
       result[i*2+0].setY(key);
-      result[i*2+1].setX(valueAxis->coordToPixel(data.at(i).value));
+      result[i*2+1].setX(value);
       result[i*2+1].setY(key);
     }
   } else // key axis is horizontal
   {
-    for (int i=0; i<data.size(); ++i)
+    for (int i=0; i<n; ++i)
     {
-      const double key = keyAxis->coordToPixel(data.at(i).key);
+      const double key = points[i].x();
+      const double value = points[i].y();
       result[i*2+0].setX(key);
-      result[i*2+0].setY(valueAxis->coordToPixel(0));
+      result[i*2+0].setY(zeroValue);
       result[i*2+1].setX(key);
-      result[i*2+1].setY(valueAxis->coordToPixel(data.at(i).value));
+      result[i*2+1].setY(value);
     }
   }
   return result;
@@ -21563,24 +22361,26 @@ QVector<QPointF> QCPGraph::dataToImpulseLines(const QVector<QCPGraphData> &data)
   segments of the two involved graphs, before passing the overlapping pairs to \ref
   getChannelFillPolygon.
   
-  Pass the points of this graph's line as \a lines, in pixel coordinates.
+  Pass the points of this graph's line as \a lines, in pixel coordinates. If the fill goes to the
+  zero-value-line, its polygons may be passed as \a fillPolygons, when they were already computed
+  with \ref getFillPolygons.
 
   \see drawLinePlot, drawImpulsePlot, drawScatterPlot
 */
-void QCPGraph::drawFill(QCPPainter *painter, QVector<QPointF> *lines) const
+void QCPGraph::drawFill(QCPPainter *painter, QVector<QPointF> *lines, const QVector<QPolygonF> *fillPolygons) const
 {
   if (mLineStyle == lsImpulse) return; // fill doesn't make sense for impulse plot
   if (painter->brush().style() == Qt::NoBrush || painter->brush().color().alpha() == 0) return;
   
   applyFillAntialiasingHint(painter);
-  const QVector<QCPDataRange> segments = getNonNanSegments(lines, keyAxis()->orientation());
   if (!mChannelFillGraph)
   {
     // draw base fill under graph, fill goes all the way to the zero-value-line:
-    foreach (QCPDataRange segment, segments)
-      painter->drawPolygon(getFillPolygon(lines, segment));
+    foreach (const QPolygonF &polygon, fillPolygons ? *fillPolygons : getFillPolygons(lines))
+      painter->drawPolygon(polygon);
   } else
   {
+    const QVector<QCPDataRange> segments = getNonNanSegments(lines, keyAxis()->orientation());
     // draw fill between this graph and mChannelFillGraph:
     QVector<QPointF> otherLines;
     mChannelFillGraph->getLines(&otherLines, QCPDataRange(0, mChannelFillGraph->dataCount()));
@@ -21646,6 +22446,34 @@ void QCPGraph::drawImpulsePlot(QCPPainter *painter, const QVector<QPointF> &line
   }
 }
 
+/*! \internal
+  \brief A chunk of the adaptive sampling of a QCPGraph, run in a QThreadPool
+
+  See \ref QCPGraph::getSampledLineData.
+*/
+class QCPGraphSamplingTask : public QRunnable
+{
+public:
+  QCPGraphSamplingTask(const QCPGraph *graph, QVector<QCPGraphData> *lineData, QCPGraphDataContainer::const_iterator begin, QCPGraphDataContainer::const_iterator end,
+                       QCPGraphDataContainer::const_iterator rangeBegin, QCPGraphDataContainer::const_iterator rangeEnd, QSemaphore *done) :
+    mGraph(graph), mLineData(lineData), mBegin(begin), mEnd(end), mRangeBegin(rangeBegin), mRangeEnd(rangeEnd), mDone(done)
+  {
+    setAutoDelete(false);
+  }
+  
+  virtual void run() Q_DECL_OVERRIDE
+  {
+    mGraph->sampleLineData(mLineData, mBegin, mEnd, mRangeBegin, mRangeEnd);
+    mDone->release();
+  }
+  
+private:
+  const QCPGraph *mGraph;
+  QVector<QCPGraphData> *mLineData;
+  QCPGraphDataContainer::const_iterator mBegin, mEnd, mRangeBegin, mRangeEnd;
+  QSemaphore *mDone;
+};
+
 /*! \internal
 
   Returns via \a lineData the data points that need to be visualized for this graph when plotting
@@ -21668,69 +22496,28 @@ void QCPGraph::getOptimizedLineData(QVector<QCPGraphData> *lineData, const QCPGr
   
   int dataCount = int(end-begin);
   int maxCount = (std::numeric_limits<int>::max)();
+  double keyPixelSpan = 0;
   if (mAdaptiveSampling)
   {
-    double keyPixelSpan = qAbs(keyAxis->coordToPixel(begin->key)-keyAxis->coordToPixel((end-1)->key));
+    keyPixelSpan = qAbs(keyAxis->coordToPixel(begin->key)-keyAxis->coordToPixel((end-1)->key));
     if (2*keyPixelSpan+2 < static_cast<double>((std::numeric_limits<int>::max)()))
       maxCount = int(2*keyPixelSpan+2);
   }
   
-  if (mAdaptiveSampling && dataCount >= maxCount) // use adaptive sampling only if there are at least two points per pixel on average
+  if (mAdaptiveSampling && dataCount >= maxCount && keyAxis->scaleType() == QCPAxis::stLinear) // with many points per pixel, sample buckets of the level-of-detail pyramid instead of single points
   {
-    QCPGraphDataContainer::const_iterator it = begin;
-    double minValue = it->value;
-    double maxValue = it->value;
-    QCPGraphDataContainer::const_iterator currentIntervalFirstPoint = it;
-    int reversedFactor = keyAxis->pixelOrientation(); // is used to calculate keyEpsilon pixel into the correct direction
-    int reversedRound = reversedFactor==-1 ? 1 : 0; // is used to switch between floor (normal) and ceil (reversed) rounding of currentIntervalStartKey
-    double currentIntervalStartKey = keyAxis->pixelToCoord(int(keyAxis->coordToPixel(begin->key)+reversedRound));
-    double lastIntervalEndKey = currentIntervalStartKey;
-    double keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor)); // interval of one pixel on screen when mapped to plot key coordinates
-    bool keyEpsilonVariable = keyAxis->scaleType() == QCPAxis::stLogarithmic; // indicates whether keyEpsilon needs to be updated after every interval (for log axes)
-    int intervalDataCount = 1;
-    ++it; // advance iterator to second data point because adaptive sampling works in 1 point retrospect
-    while (it != end)
+    mLodPyramid.update(*mDataContainer);
+    const int level = mLodPyramid.levelFor(dataCount/qMax(1.0, keyPixelSpan));
+    if (level >= 0)
     {
-      if (it->key < currentIntervalStartKey+keyEpsilon) // data point is still within same pixel, so skip it and expand value span of this cluster if necessary
-      {
-        if (it->value < minValue)
-          minValue = it->value;
-        else if (it->value > maxValue)
-          maxValue = it->value;
-        ++intervalDataCount;
-      } else // new pixel interval started
-      {
-        if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
-        {
-          if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point is further away, so first point of this cluster must be at a real data point
-            lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.2, currentIntervalFirstPoint->value));
-          lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
-          lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
-          if (it->key > currentIntervalStartKey+keyEpsilon*2) // new pixel started further away from previous cluster, so make sure the last point of the cluster is at a real data point
-            lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.8, (it-1)->value));
-        } else
-          lineData->append(QCPGraphData(currentIntervalFirstPoint->key, currentIntervalFirstPoint->value));
-        lastIntervalEndKey = (it-1)->key;
-        minValue = it->value;
-        maxValue = it->value;
-        currentIntervalFirstPoint = it;
-        currentIntervalStartKey = keyAxis->pixelToCoord(int(keyAxis->coordToPixel(it->key)+reversedRound));
-        if (keyEpsilonVariable)
-          keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor));
-        intervalDataCount = 1;
-      }
-      ++it;
+      getLodLineData(lineData, int(begin-mDataContainer->constBegin()), int(end-mDataContainer->constBegin()), level);
+      return;
     }
-    // handle last interval:
-    if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
-    {
-      if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point wasn't a cluster, so first point of this cluster must be at a real data point
-        lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.2, currentIntervalFirstPoint->value));
-      lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
-      lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
-    } else
-      lineData->append(QCPGraphData(currentIntervalFirstPoint->key, currentIntervalFirstPoint->value));
-    
+  }
+  
+  if (mAdaptiveSampling && dataCount >= maxCount) // use adaptive sampling only if there are at least two points per pixel on average
+  {
+    getSampledLineData(lineData, begin, end);
   } else // don't use adaptive sampling algorithm, transfer points one-to-one from the data container into the output
   {
     lineData->resize(dataCount);
@@ -21738,6 +22525,150 @@ void QCPGraph::getOptimizedLineData(QVector<QCPGraphData> *lineData, const QCPGr
   }
 }
 
+/*! \internal
+
+  Runs the adaptive sampling of \ref getOptimizedLineData over the data points from \a begin to \a
+  end, in parallel when there are many of them.
+
+  The range is split into chunks (as many as the global QThreadPool has threads, and at least 64k
+  data points each) at data points where the sampling starts a new pixel interval anyway, so every
+  chunk can be sampled on its own, with \ref sampleLineData, and their clusters concatenated into
+  the same result a single pass would give. The calling thread samples the first chunk and those
+  that no thread of the pool has started yet, so it never waits for a busy pool.
+
+  On linear key axes, ranges with many data points per pixel are sampled from the level-of-detail
+  pyramid instead (see \ref getLodLineData), so this is mostly used with logarithmic key axes.
+*/
+void QCPGraph::getSampledLineData(QVector<QCPGraphData> *lineData, const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end) const
+{
+  const int minChunkSize = 65536;
+  QCPAxis *keyAxis = mKeyAxis.data();
+  QThreadPool *pool = QThreadPool::globalInstance();
+  const int chunkCount = qBound(1, int(end-begin)/minChunkSize, qMax(1, pool->maxThreadCount()));
+  if (chunkCount == 1)
+  {
+    sampleLineData(lineData, begin, end, begin, end);
+    return;
+  }
+  
+  // move every chunk boundary to the first data point of the next pixel interval:
+  const int reversedFactor = keyAxis->pixelOrientation();
+  const int reversedRound = reversedFactor==-1 ? 1 : 0;
+  const bool keyEpsilonVariable = keyAxis->scaleType() == QCPAxis::stLogarithmic;
+  const double rangeStartKey = keyAxis->pixelToCoord(int(keyAxis->coordToPixel(begin->key)+reversedRound));
+  QVector<QCPGraphDataContainer::const_iterator> bounds;
+  bounds << begin;
+  for (int i=1; i<chunkCount; ++i)
+  {
+    const QCPGraphDataContainer::const_iterator it = begin+qint64(end-begin)*i/chunkCount;
+    const double intervalStartKey = keyAxis->pixelToCoord(int(keyAxis->coordToPixel(it->key)+reversedRound));
+    const double epsilonKey = keyEpsilonVariable ? intervalStartKey : rangeStartKey; // as in sampleLineData
+    const double keyEpsilon = qAbs(epsilonKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(epsilonKey)+1.0*reversedFactor));
+    const QCPGraphDataContainer::const_iterator bound = std::lower_bound(it, end, QCPGraphData::fromSortKey(intervalStartKey+keyEpsilon), qcpLessThanSortKey<QCPGraphData>);
+    if (bound != end && bound > bounds.last()+1)
+      bounds << bound;
+  }
+  bounds << end;
+  
+  // sample the chunks, all but the first one in the thread pool:
+  QVector<QVector<QCPGraphData> > chunkData(bounds.size()-1);
+  QSemaphore done;
+  QVector<QCPGraphSamplingTask*> tasks;
+  for (int i=1; i<chunkData.size(); ++i)
+  {
+    tasks << new QCPGraphSamplingTask(this, &chunkData[i], bounds.at(i), bounds.at(i+1), begin, end, &done);
+    pool->start(tasks.last());
+  }
+  sampleLineData(&chunkData[0], bounds.at(0), bounds.at(1), begin, end);
+  foreach (QCPGraphSamplingTask *task, tasks)
+  {
+    if (pool->tryTake(task))
+      task->run();
+  }
+  done.acquire(tasks.size());
+  qDeleteAll(tasks);
+  
+  int size = 0;
+  foreach (const QVector<QCPGraphData> &data, chunkData)
+    size += data.size();
+  lineData->reserve(lineData->size()+size);
+  foreach (const QVector<QCPGraphData> &data, chunkData)
+    *lineData << data;
+}
+
+/*! \internal
+
+  The adaptive sampling algorithm of \ref getOptimizedLineData, over the data points from \a
+  begin to \a end: consecutive data points that fall on the same pixel are consolidated into a
+  cluster of their first, minimum, maximum and last values. The sampled data points are appended
+  to \a lineData.
+
+  \a begin and \a end may be the bounds of a chunk of the whole range being sampled, from \a
+  rangeBegin to \a rangeEnd (see \ref getSampledLineData). A chunk other than the last one must end
+  with the first data point of a new pixel interval, which isn't sampled but completes the last
+  cluster of the chunk.
+*/
+void QCPGraph::sampleLineData(QVector<QCPGraphData> *lineData, const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end, const QCPGraphDataContainer::const_iterator &rangeBegin, const QCPGraphDataContainer::const_iterator &rangeEnd) const
+{
+  QCPAxis *keyAxis = mKeyAxis.data();
+  QCPGraphDataContainer::const_iterator it = begin;
+  double minValue = it->value;
+  double maxValue = it->value;
+  QCPGraphDataContainer::const_iterator currentIntervalFirstPoint = it;
+  int reversedFactor = keyAxis->pixelOrientation(); // is used to calculate keyEpsilon pixel into the correct direction
+  int reversedRound = reversedFactor==-1 ? 1 : 0; // is used to switch between floor (normal) and ceil (reversed) rounding of currentIntervalStartKey
+  double currentIntervalStartKey = keyAxis->pixelToCoord(int(keyAxis->coordToPixel(begin->key)+reversedRound));
+  double lastIntervalEndKey = begin == rangeBegin ? currentIntervalStartKey : (begin-1)->key; // a chunk continues the intervals of the previous one
+  bool keyEpsilonVariable = keyAxis->scaleType() == QCPAxis::stLogarithmic; // indicates whether keyEpsilon needs to be updated after every interval (for log axes)
+  const double rangeStartKey = keyEpsilonVariable ? currentIntervalStartKey : keyAxis->pixelToCoord(int(keyAxis->coordToPixel(rangeBegin->key)+reversedRound)); // so that all chunks use the same constant keyEpsilon
+  double keyEpsilon = qAbs(rangeStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(rangeStartKey)+1.0*reversedFactor)); // interval of one pixel on screen when mapped to plot key coordinates
+  int intervalDataCount = 1;
+  ++it; // advance iterator to second data point because adaptive sampling works in 1 point retrospect
+  while (it != end)
+  {
+    if (it->key < currentIntervalStartKey+keyEpsilon) // data point is still within same pixel, so skip it and expand value span of this cluster if necessary
+    {
+      if (it->value < minValue)
+        minValue = it->value;
+      else if (it->value > maxValue)
+        maxValue = it->value;
+      ++intervalDataCount;
+    } else // new pixel interval started
+    {
+      if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
+      {
+        if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point is further away, so first point of this cluster must be at a real data point
+          lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.2, currentIntervalFirstPoint->value));
+        lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
+        lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
+        if (it->key > currentIntervalStartKey+keyEpsilon*2) // new pixel started further away from previous cluster, so make sure the last point of the cluster is at a real data point
+          lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.8, (it-1)->value));
+      } else
+        lineData->append(QCPGraphData(currentIntervalFirstPoint->key, currentIntervalFirstPoint->value));
+      lastIntervalEndKey = (it-1)->key;
+      minValue = it->value;
+      maxValue = it->value;
+      currentIntervalFirstPoint = it;
+      currentIntervalStartKey = keyAxis->pixelToCoord(int(keyAxis->coordToPixel(it->key)+reversedRound));
+      if (keyEpsilonVariable)
+        keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor));
+      intervalDataCount = 1;
+    }
+    ++it;
+  }
+  // handle last interval (if this is not the last chunk, end is the first data point of the next interval, handled like above):
+  if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
+  {
+    if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point wasn't a cluster, so first point of this cluster must be at a real data point
+      lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.2, currentIntervalFirstPoint->value));
+    lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
+    lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
+    if (end != rangeEnd && end->key > currentIntervalStartKey+keyEpsilon*2) // next chunk starts further away from this cluster, so make sure the last point of the cluster is at a real data point
+      lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.8, (end-1)->value));
+  } else
+    lineData->append(QCPGraphData(currentIntervalFirstPoint->key, currentIntervalFirstPoint->value));
+}
+
 /*! \internal
 
   Returns via \a scatterData the data points that need to be visualized for this graph when
@@ -21769,12 +22700,24 @@ void QCPGraph::getOptimizedScatterData(QVector<QCPGraphData> *scatterData, QCPGr
   if (begin == end) return;
   int dataCount = int(end-begin);
   int maxCount = (std::numeric_limits<int>::max)();
+  int keyPixelSpan = 0;
   if (mAdaptiveSampling)
   {
-    int keyPixelSpan = int(qAbs(keyAxis->coordToPixel(begin->key)-keyAxis->coordToPixel((end-1)->key)));
+    keyPixelSpan = int(qAbs(keyAxis->coordToPixel(begin->key)-keyAxis->coordToPixel((end-1)->key)));
     maxCount = 2*keyPixelSpan+2;
   }
   
+  if (mAdaptiveSampling && dataCount >= maxCount && !doScatterSkip && keyAxis->scaleType() == QCPAxis::stLinear) // with many points per pixel, sample buckets of the level-of-detail pyramid instead of single points
+  {
+    mLodPyramid.update(*mDataContainer);
+    const int level = mLodPyramid.levelFor(dataCount/qMax(1.0, double(keyPixelSpan)));
+    if (level >= 0)
+    {
+      getLodScatterData(scatterData, beginIndex, endIndex, level);
+      return;
+    }
+  }
+  
   if (mAdaptiveSampling && dataCount >= maxCount) // use adaptive sampling only if there are at least two points per pixel on average
   {
     double valueMaxRange = valueAxis->range().upper;
@@ -21922,6 +22865,145 @@ void QCPGraph::getOptimizedScatterData(QVector<QCPGraphData> *scatterData, QCPGr
   }
 }
 
+/*! \internal
+
+  Level-of-detail variant of the adaptive sampling of \ref getOptimizedLineData, used when many
+  data points fall on each pixel of a linear key axis. It produces the same clusters per pixel
+  (first value, minimum, maximum and last value), but walks the spans returned by \ref
+  QCPGraphLodPyramid::nextSpan, i.e. buckets of \a level (holding about one pixel worth of data
+  points) and their precomputed extrema, instead of every data point between \a beginIndex and \a
+  endIndex.
+*/
+void QCPGraph::getLodLineData(QVector<QCPGraphData> *lineData, int beginIndex, int endIndex, int level) const
+{
+  QCPAxis *keyAxis = mKeyAxis.data();
+  const QCPGraphDataContainer::const_iterator data = mDataContainer->constBegin();
+  QCPGraphLodPyramid::Span span;
+  int index = mLodPyramid.nextSpan(*mDataContainer, beginIndex, endIndex, level, span);
+  double minValue = span.minValue;
+  double maxValue = span.maxValue;
+  int currentIntervalFirstIndex = beginIndex;
+  int previousIndex = index-1; // last data point of the previous span
+  int reversedFactor = keyAxis->pixelOrientation(); // is used to calculate keyEpsilon pixel into the correct direction
+  int reversedRound = reversedFactor==-1 ? 1 : 0; // is used to switch between floor (normal) and ceil (reversed) rounding of currentIntervalStartKey
+  double currentIntervalStartKey = keyAxis->pixelToCoord(int(keyAxis->coordToPixel((data+beginIndex)->key)+reversedRound));
+  double lastIntervalEndKey = currentIntervalStartKey;
+  double keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor)); // interval of one pixel on screen when mapped to plot key coordinates
+  int intervalDataCount = span.count;
+  while (index < endIndex)
+  {
+    index = mLodPyramid.nextSpan(*mDataContainer, index, endIndex, level, span);
+    const double spanKey = (data+span.begin)->key;
+    if (spanKey < currentIntervalStartKey+keyEpsilon) // span starts within the same pixel, so expand value span of this cluster if necessary
+    {
+      if (span.minValue < minValue || qIsNaN(minValue))
+        minValue = span.minValue;
+      if (span.maxValue > maxValue || qIsNaN(maxValue))
+        maxValue = span.maxValue;
+      intervalDataCount += span.count;
+    } else // new pixel interval started
+    {
+      if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
+      {
+        if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point is further away, so first point of this cluster must be at a real data point
+          lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.2, (data+currentIntervalFirstIndex)->value));
+        lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
+        lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
+        if (spanKey > currentIntervalStartKey+keyEpsilon*2) // new pixel started further away from previous cluster, so make sure the last point of the cluster is at a real data point
+          lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.8, (data+previousIndex)->value));
+      } else
+        lineData->append(*(data+currentIntervalFirstIndex));
+      lastIntervalEndKey = (data+previousIndex)->key;
+      minValue = span.minValue;
+      maxValue = span.maxValue;
+      currentIntervalFirstIndex = span.begin;
+      currentIntervalStartKey = keyAxis->pixelToCoord(int(keyAxis->coordToPixel(spanKey)+reversedRound));
+      intervalDataCount = span.count;
+    }
+    previousIndex = index-1;
+  }
+  // handle last interval:
+  if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
+  {
+    if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point wasn't a cluster, so first point of this cluster must be at a real data point
+      lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.2, (data+currentIntervalFirstIndex)->value));
+    lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
+    lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
+  } else
+    lineData->append(*(data+currentIntervalFirstIndex));
+}
+
+/*! \internal
+
+  Level-of-detail variant of the adaptive sampling of \ref getOptimizedScatterData, used when many
+  data points fall on each pixel of a linear key axis and no scatters are skipped. For every
+  pixel, the data points holding the minimum and maximum values of the spans returned by \ref
+  QCPGraphLodPyramid::nextSpan (buckets of \a level, or single data points) are output, thinned
+  out to approximately one every 4 value pixels like \ref getOptimizedScatterData does, but
+  always including the extrema of the pixel.
+*/
+void QCPGraph::getLodScatterData(QVector<QCPGraphData> *scatterData, int beginIndex, int endIndex, int level) const
+{
+  QCPAxis *keyAxis = mKeyAxis.data();
+  QCPAxis *valueAxis = mValueAxis.data();
+  const QCPGraphDataContainer::const_iterator data = mDataContainer->constBegin();
+  const double valueMaxRange = valueAxis->range().upper;
+  const double valueMinRange = valueAxis->range().lower;
+  QVector<QCPGraphLodPyramid::Span> intervalSpans; // spans starting within the current pixel
+  QCPGraphLodPyramid::Span span;
+  int reversedFactor = keyAxis->pixelOrientation(); // is used to calculate keyEpsilon pixel into the correct direction
+  int reversedRound = reversedFactor==-1 ? 1 : 0; // is used to switch between floor (normal) and ceil (reversed) rounding of currentIntervalStartKey
+  double currentIntervalStartKey = keyAxis->pixelToCoord(int(keyAxis->coordToPixel((data+beginIndex)->key)+reversedRound));
+  double keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor)); // interval of one pixel on screen when mapped to plot key coordinates
+  int index = beginIndex;
+  for (;;)
+  {
+    const bool finished = index >= endIndex;
+    if (!finished)
+    {
+      index = mLodPyramid.nextSpan(*mDataContainer, index, endIndex, level, span);
+      const double spanKey = (data+span.begin)->key;
+      if (intervalSpans.isEmpty() || spanKey < currentIntervalStartKey+keyEpsilon) // span starts within the same pixel
+      {
+        if (intervalSpans.isEmpty())
+          currentIntervalStartKey = keyAxis->pixelToCoord(int(keyAxis->coordToPixel(spanKey)+reversedRound));
+        intervalSpans.append(span);
+        continue;
+      }
+    }
+    // pixel interval finished, output its scatters:
+    double minValue = intervalSpans.first().minValue;
+    double maxValue = intervalSpans.first().maxValue;
+    for (int i=1; i<intervalSpans.size(); ++i)
+    {
+      if (intervalSpans.at(i).minValue < minValue || qIsNaN(minValue))
+        minValue = intervalSpans.at(i).minValue;
+      if (intervalSpans.at(i).maxValue > maxValue || qIsNaN(maxValue))
+        maxValue = intervalSpans.at(i).maxValue;
+    }
+    double valuePixelSpan = qAbs(valueAxis->coordToPixel(minValue)-valueAxis->coordToPixel(maxValue));
+    int spanModulo = valuePixelSpan > 0 ? qMax(1, int(qMin(double(intervalSpans.size()), 2*intervalSpans.size()/(valuePixelSpan/4.0)+0.5))) : intervalSpans.size(); // approximately every 4 value pixels one data point on average
+    for (int i=0; i<intervalSpans.size(); ++i)
+    {
+      const QCPGraphLodPyramid::Span &intervalSpan = intervalSpans.at(i);
+      if (i % spanModulo != 0 && intervalSpan.minValue != minValue && intervalSpan.maxValue != maxValue)
+        continue;
+      const QCPGraphData &minData = *(data+intervalSpan.minIndex);
+      if (minData.value > valueMinRange && minData.value < valueMaxRange)
+        scatterData->append(minData);
+      const QCPGraphData &maxData = *(data+intervalSpan.maxIndex);
+      if (intervalSpan.maxIndex != intervalSpan.minIndex && maxData.value > valueMinRange && maxData.value < valueMaxRange)
+        scatterData->append(maxData);
+    }
+    intervalSpans.clear();
+    if (finished)
+      break;
+    // the span that started the new pixel interval:
+    currentIntervalStartKey = keyAxis->pixelToCoord(int(keyAxis->coordToPixel((data+span.begin)->key)+reversedRound));
+    intervalSpans.append(span);
+  }
+}
+
 /*!
   This method outputs the currently visible data range via \a begin and \a end. The returned range
   will also never exceed \a rangeRestriction.
@@ -22187,6 +23269,24 @@ const QPolygonF QCPGraph::getFillPolygon(const QVector<QPointF> *lineData, QCPDa
   return result;
 }
 
+/*! \internal
+
+  Returns the polygons of the fill that goes to the zero-value-line under the line \a lines (in
+  pixel coordinates): one polygon (see \ref getFillPolygon) per non-NaN segment of the line (see
+  \ref getNonNanSegments).
+
+  \see drawFill
+*/
+QVector<QPolygonF> QCPGraph::getFillPolygons(const QVector<QPointF> *lines) const
+{
+  const QVector<QCPDataRange> segments = getNonNanSegments(lines, keyAxis()->orientation());
+  QVector<QPolygonF> result;
+  result.reserve(segments.size());
+  foreach (QCPDataRange segment, segments)
+    result.append(getFillPolygon(lines, segment));
+  return result;
+}
+
 /*! \internal
   
   Returns the polygon needed for drawing (partial) channel fills between this graph and the graph
@@ -22400,25 +23500,21 @@ double QCPGraph::pointDistance(const QPointF &pixelPoint, QCPGraphDataContainer:
   pixelsToCoords(pixelPoint+QPointF(mParentPlot->selectionTolerance(), mParentPlot->selectionTolerance()), posKeyMax, dummy);
   if (posKeyMin > posKeyMax)
     qSwap(posKeyMin, posKeyMax);
-  // iterate over found data points and then choose the one with the shortest distance to pos:
-  QCPGraphDataContainer::const_iterator begin = mDataContainer->findBegin(posKeyMin, true);
-  QCPGraphDataContainer::const_iterator end = mDataContainer->findEnd(posKeyMax, true);
-  for (QCPGraphDataContainer::const_iterator it=begin; it!=end; ++it)
-  {
-    const double currentDistSqr = QCPVector2D(coordsToPixels(it->key, it->value)-pixelPoint).lengthSquared();
-    if (currentDistSqr < minDistSqr)
-    {
-      minDistSqr = currentDistSqr;
-      closestData = it;
-    }
-  }
+  // find the data point with the shortest distance to pos among those in that key range:
+  const int beginIndex = int(mDataContainer->findBegin(posKeyMin, true)-mDataContainer->constBegin());
+  const int endIndex = int(mDataContainer->findEnd(posKeyMax, true)-mDataContainer->constBegin());
+  findClosestData(pixelPoint, beginIndex, endIndex, minDistSqr, closestData);
     
   // calculate distance to graph line if there is one (if so, will probably be smaller than distance to closest data point):
   if (mLineStyle != lsNone)
   {
-    // line displayed, calculate distance to line segments:
+    // line displayed, calculate distance to line segments. A segment is at least as far from the
+    // test point as its key span, so only the segments touching the key range (the data points in
+    // it, and one more on each side for step styles) can be within the selection tolerance. Even
+    // sharp spikes are found, since the lines of that range are sampled with the same min/max
+    // buckets as the drawn ones:
     QVector<QPointF> lineData;
-    getLines(&lineData, QCPDataRange(0, dataCount())); // don't limit data range further since with sharp data spikes, line segments may be closer to test point than segments with closer key coordinate
+    getLines(&lineData, QCPDataRange(beginIndex-1, endIndex+1));
     QCPVector2D p(pixelPoint);
     const int step = mLineStyle==lsImpulse ? 2 : 1; // impulse plot differs from other line styles in that the lineData points are only pairwise connected
     for (int i=0; i<lineData.size()-1; i+=step)
@@ -22432,6 +23528,86 @@ double QCPGraph::pointDistance(const QPointF &pixelPoint, QCPGraphDataContainer:
   return qSqrt(minDistSqr);
 }
 
+/*! \internal
+
+  Orders buckets of the level-of-detail pyramid by their distance, for \ref findClosestData.
+*/
+static bool lessThanSpanDistance(const QPair<double, QCPGraphLodPyramid::Span> &a, const QPair<double, QCPGraphLodPyramid::Span> &b)
+{
+  return a.first < b.first;
+}
+
+/*! \internal
+
+  Finds the data point between \a beginIndex and \a endIndex that is closest to \a pixelPoint, if
+  its squared distance in pixels is smaller than \a minDistSqr. In that case it is returned in \a
+  closestData, and its squared distance in \a minDistSqr.
+
+  When the range holds many data points, they are searched through the buckets of the
+  level-of-detail pyramid (see \ref QCPGraphLodPyramid): every bucket spans a rectangle from its
+  first to its last key and from its minimum to its maximum value, and only the data points of the
+  buckets whose rectangle is closer to \a pixelPoint than the closest data point found so far are
+  visited. Buckets are visited by increasing distance of their rectangles, so usually only those
+  next to \a pixelPoint are, whatever the number of data points in the range.
+
+  Used by \ref pointDistance.
+*/
+void QCPGraph::findClosestData(const QPointF &pixelPoint, int beginIndex, int endIndex, double &minDistSqr, QCPGraphDataContainer::const_iterator &closestData) const
+{
+  const int bucketsPerRange = 64; // search the buckets of the coarsest level with about that many of them in the range
+  const QCPGraphDataContainer::const_iterator dataBegin = mDataContainer->constBegin();
+  
+  int level = -1;
+  if (endIndex-beginIndex >= bucketsPerRange << QCPGraphLodPyramid::BaseLevelShift)
+  {
+    mLodPyramid.update(*mDataContainer);
+    level = mLodPyramid.levelFor((endIndex-beginIndex)/double(bucketsPerRange));
+  }
+  if (level < 0) // few data points, check all of them
+  {
+    for (QCPGraphDataContainer::const_iterator it=dataBegin+beginIndex; it!=dataBegin+endIndex; ++it)
+    {
+      const double currentDistSqr = QCPVector2D(coordsToPixels(it->key, it->value)-pixelPoint).lengthSquared();
+      if (currentDistSqr < minDistSqr)
+      {
+        minDistSqr = currentDistSqr;
+        closestData = it;
+      }
+    }
+    return;
+  }
+  
+  // squared distance from pixelPoint to the rectangle of every bucket (or single data point):
+  QVector<QPair<double, QCPGraphLodPyramid::Span> > spans;
+  QCPGraphLodPyramid::Span span;
+  for (int index=beginIndex; index<endIndex; )
+  {
+    index = mLodPyramid.nextSpan(*mDataContainer, index, endIndex, level, span);
+    if (qIsNaN(span.minValue)) // only NaN values, which are never the closest
+      continue;
+    const QRectF rect = QRectF(coordsToPixels((dataBegin+span.begin)->key, span.minValue),
+                               coordsToPixels((dataBegin+span.begin+span.count-1)->key, span.maxValue)).normalized();
+    const double dx = qMax(qMax(rect.left()-pixelPoint.x(), pixelPoint.x()-rect.right()), 0.0);
+    const double dy = qMax(qMax(rect.top()-pixelPoint.y(), pixelPoint.y()-rect.bottom()), 0.0);
+    spans.append(qMakePair(dx*dx+dy*dy, span));
+  }
+  std::sort(spans.begin(), spans.end(), lessThanSpanDistance);
+  
+  for (int i=0; i<spans.size() && spans.at(i).first < minDistSqr; ++i)
+  {
+    const QCPGraphLodPyramid::Span &current = spans.at(i).second;
+    for (QCPGraphDataContainer::const_iterator it=dataBegin+current.begin; it!=dataBegin+current.begin+current.count; ++it)
+    {
+      const double currentDistSqr = QCPVector2D(coordsToPixels(it->key, it->value)-pixelPoint).lengthSquared();
+      if (currentDistSqr < minDistSqr)
+      {
+        minDistSqr = currentDistSqr;
+        closestData = it;
+      }
+    }
+  }
+}
+
 /*! \internal
   
   Finds the highest index of \a data, whose points y value is just below \a y. Assumes y values in
@@ -23028,6 +24204,9 @@ void QCPCurve::drawScatterPlot(QCPPainter *painter, const QVector<QPointF> &poin
   Methods that are also involved in the algorithm are: \ref getRegion, \ref getOptimizedPoint, \ref
   getOptimizedCornerPoints \ref mayTraverse, \ref getTraverse, \ref getTraverseCornerPoints.
 
+  Data points inside the visible rect are added in plot coordinates first, and transformed to
+  pixels at the end in runs of consecutive points, with \ref coordsToPixels.
+
   \see drawCurveLine, drawScatterPlot
 */
 void QCPCurve::getCurveLines(QVector<QPointF> *lines, const QCPDataRange &dataRange, double penWidth) const
@@ -23052,6 +24231,7 @@ void QCPCurve::getCurveLines(QVector<QPointF> *lines, const QCPDataRange &dataRa
   QCPCurveDataContainer::const_iterator it = itBegin;
   QCPCurveDataContainer::const_iterator prevIt = itEnd-1;
   int prevRegion = getRegion(prevIt->key, prevIt->value, keyMin, valueMax, keyMax, valueMin);
+  QVector<int> dataPoints; // indices in lines of the points added at their original position, still in plot coordinates
   QVector<QPointF> trailingPoints; // points that must be applied after all other points (are generated only when handling first point to get virtual segment between last and first point right)
   while (it != itEnd)
   {
@@ -23094,13 +24274,15 @@ void QCPCurve::getCurveLines(QVector<QPointF> *lines, const QCPDataRange &dataRa
           trailingPoints << getOptimizedPoint(prevRegion, prevIt->key, prevIt->value, it->key, it->value, keyMin, valueMax, keyMax, valueMin);
         else
           lines->append(getOptimizedPoint(prevRegion, prevIt->key, prevIt->value, it->key, it->value, keyMin, valueMax, keyMax, valueMin));
-        lines->append(coordsToPixels(it->key, it->value));
+        dataPoints.append(lines->size());
+        lines->append(QPointF(it->key, it->value));
       }
     } else // region didn't change
     {
       if (currentRegion == 5) // still in R, keep adding original points
       {
-        lines->append(coordsToPixels(it->key, it->value));
+        dataPoints.append(lines->size());
+        lines->append(QPointF(it->key, it->value));
       } else // still outside R, no need to add anything
       {
         // see how this is not doing anything? That's the main optimization...
@@ -23110,6 +24292,24 @@ void QCPCurve::getCurveLines(QVector<QPointF> *lines, const QCPDataRange &dataRa
     prevRegion = currentRegion;
     ++it;
   }
+  
+  // transform the original points to pixels, every run of consecutive ones at once
+  for (int run=0; run<dataPoints.size(); )
+  {
+    int runEnd = run+1;
+    while (runEnd < dataPoints.size() && dataPoints.at(runEnd) == dataPoints.at(runEnd-1)+1)
+      ++runEnd;
+    QPointF *points = lines->data()+dataPoints.at(run);
+    if (sizeof(qreal) == sizeof(double))
+    {
+      coordsToPixels(reinterpret_cast<const double*>(points), points, runEnd-run);
+    } else
+    {
+      for (int k=0; k<runEnd-run; ++k)
+        points[k] = coordsToPixels(points[k].x(), points[k].y());
+    }
+    run = runEnd;
+  }
   *lines << trailingPoints;
 }
 
@@ -66,6 +66,7 @@
 #include <QtCore/QStack>
 #include <QtCore/QCache>
 #include <QtCore/QMargins>
+#include <QtCore/QAtomicInt>
 #include <qmath.h>
 #include <limits>
 #include <algorithm>
@@ -127,6 +128,7 @@ class QCPPolarAxisRadial;
 class QCPPolarAxisAngular;
 class QCPPolarGrid;
 class QCPPolarGraph;
+class QCPRasterJob;
 
 /* including file 'src/global.h'            */
 /* modified 2021-03-29T02:30:44, size 16981 */
@@ -259,6 +261,8 @@ enum PlottingHint { phNone              = 0x000 ///< <tt>0x000</tt> No hints are
                     ,phImmediateRefresh = 0x002 ///< <tt>0x002</tt> causes an immediate repaint() instead of a soft update() when QCustomPlot::replot() is called with parameter \ref QCustomPlot::rpRefreshHint.
                                                 ///<                This is set by default to prevent the plot from freezing on fast consecutive replots (e.g. user drags ranges with mouse).
                     ,phCacheLabels      = 0x004 ///< <tt>0x004</tt> axis (tick) labels will be cached as pixmaps, increasing replot performance.
+                    ,phAsyncRasterization = 0x008 ///< <tt>0x008</tt> buffered layers holding only plottables (see \ref QCPLayer::lmBuffered) are rasterized on a background thread. QCustomPlot::replot() records them
+                                                  ///<                and returns, and the previous frame of these layers stays on screen until the new one is ready (see \ref QCustomPlot::afterRasterization).
                   };
 Q_DECLARE_FLAGS(PlottingHints, PlottingHint)
 
@@ -2280,6 +2284,8 @@ public:
   void rescale(bool onlyVisiblePlottables=false);
   double pixelToCoord(double value) const;
   double coordToPixel(double value) const;
+  void coordsToPixels(const double *coords, double *pixels, int count, int coordStride=1, int pixelStride=1) const;
+  void coordToPixelTransform(double &origin, double &scale, double &offset) const;
   SelectablePart getPartAt(const QPointF &pos) const;
   QList<QCPAbstractPlottable*> plottables() const;
   QList<QCPGraph*> graphs() const;
@@ -2574,6 +2580,14 @@ Q_DECLARE_METATYPE(QCPScatterStyle::ScatterShape)
 template <class DataType>
 inline bool qcpLessThanSortKey(const DataType &a, const DataType &b) { return a.sortKey() < b.sortKey(); }
 
+/*! \relates QCPDataContainer
+  Returns a new revision number for a QCPDataContainer, different from all revisions handed out
+  before (to any container).
+
+  \see QCPDataContainer::revision
+*/
+inline int qcpNextDataRevision() { static QAtomicInt revision; return revision.fetchAndAddRelaxed(1)+1; }
+
 template <class DataType>
 class QCPDataContainer // no QCP_LIB_DECL, template class ends up in header (cpp included below)
 {
@@ -2587,6 +2601,8 @@ public:
   int size() const { return mData.size()-mPreallocSize; }
   bool isEmpty() const { return size() == 0; }
   bool autoSqueeze() const { return mAutoSqueeze; }
+  int revision() const { return mRevision; }
+  qint64 frontOffset() const { return mFrontOffset; }
   
   // setters:
   void setAutoSqueeze(bool enabled);
@@ -2625,6 +2641,8 @@ protected:
   QVector<DataType> mData;
   int mPreallocSize;
   int mPreallocIteration;
+  int mRevision;
+  qint64 mFrontOffset;
   
   // non-virtual methods:
   void preallocateGrow(int minimumPreallocSize);
@@ -2717,6 +2735,29 @@ protected:
   Returns whether this container holds no data points.
 */
 
+/*! \fn int QCPDataContainer<DataType>::revision() const
+
+  Returns the revision of the data in this container. It changes whenever data points are
+  inserted, prepended or removed (other than from the front, see \ref frontOffset), but not when
+  data points are appended after the existing ones.
+
+  Summaries of the data that are maintained incrementally, like the level-of-detail pyramid of
+  QCPGraph, use it to tell whether they only need to take the appended data points into account,
+  or must be rebuilt.
+
+  \see frontOffset
+*/
+
+/*! \fn qint64 QCPDataContainer<DataType>::frontOffset() const
+
+  Returns the number of data points removed from the front of the container (e.g. with \ref
+  removeBefore) over its lifetime. The data point at index \a i is the \a (frontOffset()+i)-th data
+  point appended since the last change of \ref revision, which gives data points a position that
+  doesn't change when older ones are removed.
+
+  \see revision
+*/
+
 /*! \fn QCPDataContainer::const_iterator QCPDataContainer<DataType>::constBegin() const
   
   Returns a const iterator to the first data point in this container.
@@ -2733,7 +2774,8 @@ protected:
 
   You can manipulate the data points in-place through the non-const iterators, but great care must
   be taken when manipulating the sort key of a data point, see \ref sort, or the detailed
-  description of this class.
+  description of this class. Call \ref sort after changing any member of existing data points, so
+  the \ref revision changes.
 */
 
 /*! \fn QCPDataContainer::iterator QCPDataContainer<DataType>::end() const
@@ -2771,7 +2813,9 @@ template <class DataType>
 QCPDataContainer<DataType>::QCPDataContainer() :
   mAutoSqueeze(true),
   mPreallocSize(0),
-  mPreallocIteration(0)
+  mPreallocIteration(0),
+  mRevision(qcpNextDataRevision()),
+  mFrontOffset(0)
 {
 }
 
@@ -2822,6 +2866,7 @@ void QCPDataContainer<DataType>::set(const QVector<DataType> &data, bool already
   mData = data;
   mPreallocSize = 0;
   mPreallocIteration = 0;
+  mRevision = qcpNextDataRevision();
   if (!alreadySorted)
     sort();
 }
@@ -2847,12 +2892,16 @@ void QCPDataContainer<DataType>::add(const QCPDataContainer<DataType> &data)
       preallocateGrow(n);
     mPreallocSize -= n;
     std::copy(data.constBegin(), data.constEnd(), begin());
+    mRevision = qcpNextDataRevision();
   } else // don't need to prepend, so append and merge if necessary
   {
     mData.resize(mData.size()+n);
     std::copy(data.constBegin(), data.constEnd(), end()-n);
     if (oldSize > 0 && !qcpLessThanSortKey<DataType>(*(constEnd()-n-1), *(constEnd()-n))) // if appended range keys aren't all greater than existing ones, merge the two partitions
+    {
       std::inplace_merge(begin(), end()-n, end(), qcpLessThanSortKey<DataType>);
+      mRevision = qcpNextDataRevision();
+    }
   }
 }
 
@@ -2862,6 +2911,10 @@ void QCPDataContainer<DataType>::add(const QCPDataContainer<DataType> &data)
   If you can guarantee that the data points in \a data have ascending order with respect to the
   DataType's sort key, set \a alreadySorted to true to avoid an unnecessary sorting run.
   
+  Sorted data whose keys are greater than or equal to the existing ones is simply appended (in
+  amortized constant time per data point), keeping the insertion order of data points with equal
+  keys. This makes continuously appending streamed data cheap regardless of the container size.
+  
   \see set, remove
 */
 template <class DataType>
@@ -2878,20 +2931,24 @@ void QCPDataContainer<DataType>::add(const QVector<DataType> &data, bool already
   const int n = data.size();
   const int oldSize = size();
   
-  if (alreadySorted && oldSize > 0 && !qcpLessThanSortKey<DataType>(*constBegin(), *(data.constEnd()-1))) // prepend if new data is sorted and keys are all smaller than or equal to existing ones
+  if (alreadySorted && oldSize > 0 && qcpLessThanSortKey<DataType>(*(data.constEnd()-1), *constBegin())) // prepend if new data is sorted and keys are all smaller than existing ones
   {
     if (mPreallocSize < n)
       preallocateGrow(n);
     mPreallocSize -= n;
     std::copy(data.constBegin(), data.constEnd(), begin());
+    mRevision = qcpNextDataRevision();
   } else // don't need to prepend, so append and then sort and merge if necessary
   {
     mData.resize(mData.size()+n);
     std::copy(data.constBegin(), data.constEnd(), end()-n);
     if (!alreadySorted) // sort appended subrange if it wasn't already sorted
       std::sort(end()-n, end(), qcpLessThanSortKey<DataType>);
-    if (oldSize > 0 && !qcpLessThanSortKey<DataType>(*(constEnd()-n-1), *(constEnd()-n))) // if appended range keys aren't all greater than existing ones, merge the two partitions
+    if (oldSize > 0 && qcpLessThanSortKey<DataType>(*(constEnd()-n), *(constEnd()-n-1))) // if appended range keys aren't all greater than or equal to existing ones, merge the two partitions
+    {
       std::inplace_merge(begin(), end()-n, end(), qcpLessThanSortKey<DataType>);
+      mRevision = qcpNextDataRevision();
+    }
   }
 }
 
@@ -2913,10 +2970,12 @@ void QCPDataContainer<DataType>::add(const DataType &data)
       preallocateGrow(1);
     --mPreallocSize;
     *begin() = data;
+    mRevision = qcpNextDataRevision();
   } else // handle inserts, maintaining sorted keys
   {
     QCPDataContainer<DataType>::iterator insertionPoint = std::lower_bound(begin(), end(), data, qcpLessThanSortKey<DataType>);
     mData.insert(insertionPoint, data);
+    mRevision = qcpNextDataRevision();
   }
 }
 
@@ -2931,6 +2990,7 @@ void QCPDataContainer<DataType>::removeBefore(double sortKey)
   QCPDataContainer<DataType>::iterator it = begin();
   QCPDataContainer<DataType>::iterator itEnd = std::lower_bound(begin(), end(), DataType::fromSortKey(sortKey), qcpLessThanSortKey<DataType>);
   mPreallocSize += int(itEnd-it); // don't actually delete, just add it to the preallocated block (if it gets too large, squeeze will take care of it)
+  mFrontOffset += itEnd-it;
   if (mAutoSqueeze)
     performAutoSqueeze();
 }
@@ -2945,6 +3005,8 @@ void QCPDataContainer<DataType>::removeAfter(double sortKey)
 {
   QCPDataContainer<DataType>::iterator it = std::upper_bound(begin(), end(), DataType::fromSortKey(sortKey), qcpLessThanSortKey<DataType>);
   QCPDataContainer<DataType>::iterator itEnd = end();
+  if (it != itEnd)
+    mRevision = qcpNextDataRevision();
   mData.erase(it, itEnd); // typically adds it to the postallocated block
   if (mAutoSqueeze)
     performAutoSqueeze();
@@ -2965,6 +3027,8 @@ void QCPDataContainer<DataType>::remove(double sortKeyFrom, double sortKeyTo)
   
   QCPDataContainer<DataType>::iterator it = std::lower_bound(begin(), end(), DataType::fromSortKey(sortKeyFrom), qcpLessThanSortKey<DataType>);
   QCPDataContainer<DataType>::iterator itEnd = std::upper_bound(it, end(), DataType::fromSortKey(sortKeyTo), qcpLessThanSortKey<DataType>);
+  if (it != itEnd)
+    mRevision = qcpNextDataRevision();
   mData.erase(it, itEnd);
   if (mAutoSqueeze)
     performAutoSqueeze();
@@ -2986,9 +3050,14 @@ void QCPDataContainer<DataType>::remove(double sortKey)
   if (it != end() && it->sortKey() == sortKey)
   {
     if (it == begin())
+    {
       ++mPreallocSize; // don't actually delete, just add it to the preallocated block (if it gets too large, squeeze will take care of it)
-    else
+      ++mFrontOffset;
+    } else
+    {
       mData.erase(it);
+      mRevision = qcpNextDataRevision();
+    }
   }
   if (mAutoSqueeze)
     performAutoSqueeze();
@@ -3005,6 +3074,7 @@ void QCPDataContainer<DataType>::clear()
   mData.clear();
   mPreallocIteration = 0;
   mPreallocSize = 0;
+  mRevision = qcpNextDataRevision();
 }
 
 /*!
@@ -3022,6 +3092,7 @@ template <class DataType>
 void QCPDataContainer<DataType>::sort()
 {
   std::sort(begin(), end(), qcpLessThanSortKey<DataType>);
+  mRevision = qcpNextDataRevision();
 }
 
 /*!
@@ -3508,6 +3579,7 @@ public:
   // non-property methods:
   void coordsToPixels(double key, double value, double &x, double &y) const;
   const QPointF coordsToPixels(double key, double value) const;
+  void coordsToPixels(const double *keyValues, QPointF *pixels, int count) const;
   void pixelsToCoords(double x, double y, double &key, double &value) const;
   void pixelsToCoords(const QPointF &pixelPos, double &key, double &value) const;
   void rescaleAxes(bool onlyEnlarge=false) const;
@@ -3545,6 +3617,8 @@ protected:
   
   // introduced virtual methods:
   virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const = 0;
+  virtual void prepareGeometry() {}
+  virtual void discardGeometry() {}
   
   // non-virtual methods:
   void applyFillAntialiasingHint(QCPPainter *painter) const;
@@ -3556,6 +3630,7 @@ private:
   friend class QCustomPlot;
   friend class QCPAxis;
   friend class QCPPlottableLegendItem;
+  friend class QCPPlottablePreparationTask;
 };
 
 
@@ -3927,6 +4002,7 @@ signals:
   void beforeReplot();
   void afterLayout();
   void afterReplot();
+  void afterRasterization();
   
 protected:
   // property members:
@@ -3965,6 +4041,7 @@ protected:
   bool mReplotting;
   bool mReplotQueued;
   double mReplotTime, mReplotTimeAverage;
+  QCPRasterJob *mRasterJob, *mPendingRasterJob;
   int mOpenGlMultisamples;
   QCP::AntialiasedElements mOpenGlAntialiasedElementsBackup;
   bool mOpenGlCacheLabelsBackup;
@@ -4002,6 +4079,10 @@ protected:
   QCPLayerable *layerableAt(const QPointF &pos, bool onlySelectable, QVariant *selectionDetails=nullptr) const;
   QList<QCPLayerable*> layerableListAt(const QPointF &pos, bool onlySelectable, QList<QVariant> *selectionDetails=nullptr) const;
   void drawBackground(QCPPainter *painter);
+  void preparePlottables(QList<QCPAbstractPlottable*> &prepared);
+  bool rasterizesAsync(QCPLayer *layer) const;
+  void startRasterization(QCPRasterJob *job);
+  Q_SLOT void finishRasterization();
   void setupPaintBuffers();
   QCPAbstractPaintBuffer *createPaintBuffer();
   bool hasInvalidatedPaintBuffers();
@@ -5454,6 +5535,51 @@ Q_DECLARE_TYPEINFO(QCPGraphData, Q_PRIMITIVE_TYPE);
 */
 typedef QCPDataContainer<QCPGraphData> QCPGraphDataContainer;
 
+class QCP_LIB_DECL QCPGraphLodPyramid
+{
+public:
+  /*!
+    Summary of a span of consecutive data points: either a single data point or a bucket of the
+    pyramid. Indices are indices in the data container.
+  */
+  struct Span
+  {
+    int begin, count;
+    double minValue, maxValue;
+    int minIndex, maxIndex;
+  };
+  
+  QCPGraphLodPyramid();
+  
+  // non-virtual methods:
+  void clear();
+  void update(const QCPGraphDataContainer &data);
+  int levelFor(double pointsPerPixel) const;
+  int nextSpan(const QCPGraphDataContainer &data, int index, int end, int maxLevel, Span &span) const;
+  
+  static const int BaseLevelShift = 4; ///< the buckets of the finest level hold 2^BaseLevelShift data points
+  
+protected:
+  struct Bucket
+  {
+    double minValue, maxValue;
+    quint32 minOffset, maxOffset; // relative to the first data point of the bucket
+  };
+  
+  // non-property members:
+  const QCPGraphDataContainer *mSource;
+  int mRevision;
+  QVector<QVector<Bucket> > mLevels;
+  QVector<int> mStart;      // index in mLevels[i] of the first bucket that wasn't removed
+  QVector<qint64> mFirst;   // position (in buckets from the first data point ever appended) of mLevels[i][mStart[i]]
+  qint64 mFrontOffset;
+  qint64 mSummarized;       // position of the first data point not summarized in the finest level yet
+  
+  // non-virtual methods:
+  static Bucket merge(const Bucket &a, const Bucket &b, quint32 bOffset);
+  const Bucket *bucket(int level, qint64 position) const;
+};
+
 class QCP_LIB_DECL QCPGraph : public QCPAbstractPlottable1D<QCPGraphData>
 {
   Q_OBJECT
@@ -5517,12 +5643,25 @@ protected:
   QPointer<QCPGraph> mChannelFillGraph;
   bool mAdaptiveSampling;
   
+  /*!
+    Pixel geometry of a segment of selected or unselected data, as drawn by \ref draw.
+  */
+  struct SegmentGeometry
+  {
+    QCPDataRange dataRange;
+    bool selected;
+    QVector<QPointF> lines, scatters;
+    QVector<QPolygonF> fillPolygons; // only for fills to the zero-value-line (not channel fills)
+  };
+  
   // reimplemented virtual methods:
   virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
   virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const Q_DECL_OVERRIDE;
+  virtual void prepareGeometry() Q_DECL_OVERRIDE;
+  virtual void discardGeometry() Q_DECL_OVERRIDE;
   
   // introduced virtual methods:
-  virtual void drawFill(QCPPainter *painter, QVector<QPointF> *lines) const;
+  virtual void drawFill(QCPPainter *painter, QVector<QPointF> *lines, const QVector<QPolygonF> *fillPolygons=nullptr) const;
   virtual void drawScatterPlot(QCPPainter *painter, const QVector<QPointF> &scatters, const QCPScatterStyle &style) const;
   virtual void drawLinePlot(QCPPainter *painter, const QVector<QPointF> &lines) const;
   virtual void drawImpulsePlot(QCPPainter *painter, const QVector<QPointF> &lines) const;
@@ -5550,9 +5689,22 @@ protected:
   int findIndexBelowY(const QVector<QPointF> *data, double y) const;
   int findIndexAboveY(const QVector<QPointF> *data, double y) const;
   double pointDistance(const QPointF &pixelPoint, QCPGraphDataContainer::const_iterator &closestData) const;
+  void findClosestData(const QPointF &pixelPoint, int beginIndex, int endIndex, double &minDistSqr, QCPGraphDataContainer::const_iterator &closestData) const;
+  void getLodLineData(QVector<QCPGraphData> *lineData, int beginIndex, int endIndex, int level) const;
+  void getLodScatterData(QVector<QCPGraphData> *scatterData, int beginIndex, int endIndex, int level) const;
+  void getSegmentGeometry(QVector<SegmentGeometry> *geometry) const;
+  QVector<QPolygonF> getFillPolygons(const QVector<QPointF> *lines) const;
+  void getSampledLineData(QVector<QCPGraphData> *lineData, const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end) const;
+  void sampleLineData(QVector<QCPGraphData> *lineData, const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end, const QCPGraphDataContainer::const_iterator &rangeBegin, const QCPGraphDataContainer::const_iterator &rangeEnd) const;
+  
+  // non-property members:
+  mutable QCPGraphLodPyramid mLodPyramid;
+  QVector<SegmentGeometry> mGeometry;
+  bool mGeometryPrepared;
   
   friend class QCustomPlot;
   friend class QCPLegend;
+  friend class QCPGraphSamplingTask;
 };
 Q_DECLARE_METATYPE(QCPGraph::LineStyle)
 
@@ -0,0 +1,96 @@
+// Definition of methods for the RangeTracker class
+
+#include "rangetracker.h"
+
+#include <cmath>
+
+
+// Constructor of the RangeTracker class
+RangeTracker::RangeTracker()
+    : windowedMode(false)
+{
+    clear();
+}
+
+void RangeTracker::setWindowed(bool enabled)
+{
+    windowedMode = enabled;
+    clear();
+}
+
+void RangeTracker::add(double key, double value)
+{
+    last = key;
+    if (std::isnan(value))
+    {
+        return;
+    }
+
+    if (!windowedMode)
+    {
+        if (empty || value < runningMin) runningMin = value;
+        if (empty || value > runningMax) runningMax = value;
+        empty = false;
+        return;
+    }
+
+    // A new value makes every older value that is not smaller (larger) than it useless
+    // as a future minimum (maximum), since it will also stay in the window for longer
+    Entry entry = {key, value};
+    while (!minQueue.empty() && minQueue.back().value >= value)
+    {
+        minQueue.pop_back();
+    }
+    minQueue.push_back(entry);
+    while (!maxQueue.empty() && maxQueue.back().value <= value)
+    {
+        maxQueue.pop_back();
+    }
+    maxQueue.push_back(entry);
+    empty = false;
+}
+
+void RangeTracker::removeBefore(double key)
+{
+    if (!windowedMode)
+    {
+        return;
+    }
+    while (!minQueue.empty() && minQueue.front().key < key)
+    {
+        minQueue.pop_front();
+    }
+    while (!maxQueue.empty() && maxQueue.front().key < key)
+    {
+        maxQueue.pop_front();
+    }
+    empty = minQueue.empty();
+}
+
+void RangeTracker::clear()
+{
+    empty = true;
+    last = 0;
+    runningMin = 0;
+    runningMax = 0;
+    minQueue.clear();
+    maxQueue.clear();
+}
+
+double RangeTracker::minimum() const
+{
+    if (windowedMode)
+    {
+        return minQueue.empty() ? 0 : minQueue.front().value;
+    }
+    return runningMin;
+}
+
+double RangeTracker::maximum() const
+{
+    if (windowedMode)
+    {
+        return maxQueue.empty() ? 0 : maxQueue.front().value;
+    }
+    return runningMax;
+}
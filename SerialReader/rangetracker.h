@@ -0,0 +1,61 @@
+#ifndef RANGETRACKER_H
+#define RANGETRACKER_H
+
+#include <deque>
+
+// Definition of the class that keeps track of the range of the plotted data in constant time
+//
+// Values must be added in non-decreasing key order (time is monotonic). By default, running
+// minimum and maximum are kept for the whole history. In windowed mode, two monotonic deques
+// (increasing for the minimum, decreasing for the maximum) allow old values to be evicted with
+// removeBefore() while the extrema of the remaining ones are still known at any time.
+// Both modes cost amortized O(1) per value, NaN values are ignored.
+class RangeTracker
+{
+public:
+    RangeTracker();
+
+    // Enables or disables windowed mode. Clears the tracker
+    void setWindowed(bool enabled);
+
+    bool windowed() const { return windowedMode; }
+
+    void add(double key, double value);
+
+    // Windowed mode only: forgets the values with key smaller than key
+    void removeBefore(double key);
+
+    void clear();
+
+    bool isEmpty() const { return empty; }
+
+    double minimum() const;
+
+    double maximum() const;
+
+    // Key of the last value added (NaN values included)
+    double lastKey() const { return last; }
+
+private:
+    struct Entry
+    {
+        double key;
+        double value;
+    };
+
+    bool windowedMode;
+
+    bool empty;
+
+    double last;
+
+    double runningMin;
+
+    double runningMax;
+
+    std::deque<Entry> minQueue;
+
+    std::deque<Entry> maxQueue;
+};
+
+#endif // RANGETRACKER_H
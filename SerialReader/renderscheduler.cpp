@@ -0,0 +1,76 @@
+// Definition of methods for the RenderScheduler class
+
+#include "renderscheduler.h"
+
+#include <QtGlobal>
+
+
+// Constructor of the RenderScheduler class (60 Hz by default)
+RenderScheduler::RenderScheduler(QObject *parent)
+    : QObject(parent)
+    , rate(60)
+    , lastTick(0)
+    , windowStart(0)
+    , renderedInWindow(0)
+    , fps(0)
+    , dropped(0)
+{
+    timer = new QTimer(this);
+    timer->setTimerType(Qt::PreciseTimer);
+    timer->setInterval(1000 / rate);
+    QObject::connect(timer, &QTimer::timeout, this, &RenderScheduler::tick);
+}
+
+// Public slot that changes the frame rate, clamped to [MinFrameRate, MaxFrameRate]
+void RenderScheduler::setFrameRate(int hz)
+{
+    rate = qBound(int(MinFrameRate), hz, int(MaxFrameRate));
+    timer->setInterval(1000 / rate);
+}
+
+void RenderScheduler::start()
+{
+    clock.start();
+    lastTick = 0;
+    windowStart = 0;
+    renderedInWindow = 0;
+    fps = 0;
+    dropped = 0;
+    timer->start();
+}
+
+void RenderScheduler::stop()
+{
+    timer->stop();
+}
+
+void RenderScheduler::frameRendered()
+{
+    ++renderedInWindow;
+}
+
+// Private slot called by the timer
+//
+// If the GUI thread was blocked for longer than one frame interval, the ticks it missed are
+// counted as dropped frames. Once per second the statistics are updated and reported
+void RenderScheduler::tick()
+{
+    const qint64 now = clock.elapsed();
+    const qint64 interval = timer->interval();
+    const qint64 late = now - lastTick;
+    if (lastTick > 0 && late > interval + interval / 2)
+    {
+        dropped += quint64((late + interval / 2) / interval - 1);
+    }
+    lastTick = now;
+
+    emit frame();
+
+    if (now - windowStart >= 1000)
+    {
+        fps = renderedInWindow * 1000.0 / double(now - windowStart);
+        renderedInWindow = 0;
+        windowStart = now;
+        emit statsUpdated(fps, dropped);
+    }
+}
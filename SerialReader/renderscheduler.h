@@ -0,0 +1,69 @@
+#ifndef RENDERSCHEDULER_H
+#define RENDERSCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+
+// Definition of the class that paces the rendering of the plot
+//
+// It emits frame() at a fixed rate (10 to 120 Hz), independently of how fast samples arrive,
+// so everything received between two frames is plotted with a single replot.
+// It also measures the effective frame rate (replots actually completed per second, reported
+// through frameRendered()) and counts the frames dropped because the GUI thread was too busy
+// to service the timer in time.
+class RenderScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RenderScheduler(QObject *parent = nullptr);
+
+    static const int MinFrameRate = 10;
+
+    static const int MaxFrameRate = 120;
+
+    int frameRate() const { return rate; }
+
+    double effectiveFrameRate() const { return fps; }
+
+    quint64 droppedFrames() const { return dropped; }
+
+public slots:
+    void setFrameRate(int hz);
+
+    void start();
+
+    void stop();
+
+    // To be called every time a replot has been completed
+    void frameRendered();
+
+signals:
+    void frame();
+
+    // Emitted once per second with the current statistics
+    void statsUpdated(double fps, quint64 droppedFrames);
+
+private slots:
+    void tick();
+
+private:
+    QTimer *timer;
+
+    QElapsedTimer clock;
+
+    int rate;
+
+    qint64 lastTick;
+
+    qint64 windowStart;
+
+    int renderedInWindow;
+
+    double fps;
+
+    quint64 dropped;
+};
+
+#endif // RENDERSCHEDULER_H
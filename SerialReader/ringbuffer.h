@@ -0,0 +1,103 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Lock-free single-producer/single-consumer ring buffer
+//
+// Exactly one thread (the producer) may call push() and exactly one other thread
+// (the consumer) may call pop()/popAll()/clear(). The capacity is rounded up to a power
+// of two so that the free-running head and tail counters can be wrapped with a mask.
+// The producer only writes head and the consumer only writes tail, so no locks are needed:
+// the release/acquire pairs on those counters publish the slot contents between threads.
+template <typename T>
+class RingBuffer
+{
+public:
+    explicit RingBuffer(std::size_t capacity = 65536)
+        : head(0), tail(0)
+    {
+        std::size_t size = 2;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        buffer.resize(size);
+        mask = size - 1;
+    }
+
+    RingBuffer(const RingBuffer &) = delete;
+    RingBuffer &operator=(const RingBuffer &) = delete;
+
+    // Producer side: stores a copy of item. Returns false (and drops the item) if the ring is full
+    bool push(const T &item)
+    {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) > mask)
+        {
+            return false;
+        }
+        buffer[h & mask] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: moves the oldest item into item. Returns false if the ring is empty
+    bool pop(T &item)
+    {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = buffer[t & mask];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: calls func(item) for every item currently in the ring and releases
+    // all of their slots at once. Returns the number of items consumed.
+    template <typename Func>
+    std::size_t popAll(Func func)
+    {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        const std::size_t h = head.load(std::memory_order_acquire);
+        for (std::size_t i = t; i != h; ++i)
+        {
+            func(buffer[i & mask]);
+        }
+        tail.store(h, std::memory_order_release);
+        return h - t;
+    }
+
+    // Consumer side: discards everything currently stored
+    void clear()
+    {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    // Approximate number of stored items (exact when called from the consumer with no concurrent push)
+    std::size_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    std::size_t capacity() const
+    {
+        return mask + 1;
+    }
+
+private:
+    std::vector<T> buffer;
+
+    std::size_t mask;
+
+    // Kept on separate cache lines so producer and consumer don't false-share
+    alignas(64) std::atomic<std::size_t> head;
+
+    alignas(64) std::atomic<std::size_t> tail;
+};
+
+#endif // RINGBUFFER_H
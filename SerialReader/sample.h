@@ -0,0 +1,26 @@
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <QtGlobal>
+
+// A frame of values read from the serial port together with the time it was acquired.
+// Each value belongs to a different channel (signal) of the device.
+// The time is given in nanoseconds of a monotonic clock (or of the device clock, see DecoderSettings)
+struct Sample
+{
+    // Maximum number of channels transmitted in a single frame
+    static const int MaxChannels = 32;
+
+    qint64 time;
+
+    // When its bytes arrived and when it was decoded (LatencyStats::now(), for latency measurements)
+    qint64 received;
+
+    qint64 parsed;
+
+    int channels;
+
+    double values[MaxChannels];
+};
+
+#endif // SAMPLE_H
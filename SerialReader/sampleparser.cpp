@@ -0,0 +1,56 @@
+// Definition of methods for the SampleParser class
+
+#include "sampleparser.h"
+
+#include <cmath>
+
+
+namespace {
+
+// Powers of ten that are exactly representable as doubles
+const double exactPowersOfTen[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+}
+
+// Constructor of the SampleParser class
+SampleParser::SampleParser()
+{
+    reset();
+}
+
+// Public method that brings the parser back to its initial state
+void SampleParser::reset()
+{
+    state = stSeparator;
+    tokenSinceComma = true;
+    beginToken();
+}
+
+// Public method that converts a decimal mantissa and exponent to a double
+//
+// When the mantissa fits in the 53 bits of a double and the power of ten is exact,
+// a single multiplication or division gives the correctly rounded result.
+// Otherwise (more than 15-16 significant digits or huge exponents) it falls back to pow()
+double SampleParser::toDouble(quint64 mantissa, int exponent)
+{
+    if (mantissa == 0)
+    {
+        return 0.0;
+    }
+
+    const double m = static_cast<double>(mantissa);
+    if (mantissa <= (1ULL << 53))
+    {
+        if (exponent >= 0 && exponent <= 22)
+        {
+            return m * exactPowersOfTen[exponent];
+        } else if (exponent < 0 && exponent >= -22)
+        {
+            return m / exactPowersOfTen[-exponent];
+        }
+    }
+    return m * std::pow(10.0, exponent);
+}
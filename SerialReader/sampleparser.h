@@ -0,0 +1,229 @@
+#ifndef SAMPLEPARSER_H
+#define SAMPLEPARSER_H
+
+#include <QtGlobal>
+#include <limits>
+
+// Definition of the class that turns a stream of bytes into double values
+//
+// It is a byte-level state machine: it scans every chunk read from the serial port in place
+// and accumulates the digits of the number being read in integer registers, so a value split
+// across two chunks is simply completed on the next call. Nothing is copied or allocated per
+// sample, and the conversion to double does not depend on the locale.
+//
+// Values are separated by commas (whitespace, line breaks and semicolons are accepted as well).
+// The parser reports them to a sink object providing two methods:
+// - value(double v, qint64 position), called for every complete token (NaN if the token is not a number)
+// - endOfLine(qint64 position), called for every line feed, so the caller can group values into rows
+// where position is the index in data of the byte that completed the value or line.
+// An empty value between two commas is reported as NaN, a trailing comma before a line feed is not.
+class SampleParser
+{
+public:
+    SampleParser();
+
+    // Forgets any partially read value
+    void reset();
+
+    // Parses size bytes starting at data and reports every complete value and line end to sink
+    template <typename Sink>
+    void parse(const char *data, qint64 size, Sink &&sink);
+
+    // Converts mantissa * 10^exponent to the nearest double (exact whenever it can be)
+    static double toDouble(quint64 mantissa, int exponent);
+
+private:
+    enum State { stSeparator, stSign, stInteger, stFraction, stExponentSign, stExponentDigit, stExponent, stInvalid };
+
+    static bool isSeparator(char c)
+    {
+        return c == ',' || c == '\n' || c == '\r' || c == ' ' || c == '\t' || c == ';';
+    }
+
+    void beginToken()
+    {
+        negative = false;
+        mantissa = 0;
+        exponent = 0;
+        digits = 0;
+        expNegative = false;
+        expValue = 0;
+    }
+
+    void addDigit(int d)
+    {
+        // Only 19 significant digits fit in a quint64, the following ones only scale the value
+        if (mantissa < 1000000000000000000ULL)
+        {
+            mantissa = mantissa * 10 + d;
+        } else
+        {
+            ++exponent;
+        }
+        ++digits;
+    }
+
+    State state;
+
+    bool tokenSinceComma;
+
+    bool negative;
+
+    quint64 mantissa;
+
+    int exponent;
+
+    int digits;
+
+    bool expNegative;
+
+    int expValue;
+};
+
+template <typename Sink>
+void SampleParser::parse(const char *data, qint64 size, Sink &&sink)
+{
+    const char *end = data + size;
+    for (const char *p = data; p != end; ++p)
+    {
+        const char c = *p;
+
+        if (isSeparator(c))
+        {
+            // A separator completes the value being read (if any)
+            if (state != stSeparator)
+            {
+                if ((state == stInteger || state == stFraction || state == stExponent) && digits > 0)
+                {
+                    const int e = exponent + (expNegative ? -expValue : expValue);
+                    const double value = toDouble(mantissa, e);
+                    sink.value(negative ? -value : value, p - data);
+                } else
+                {
+                    sink.value(std::numeric_limits<double>::quiet_NaN(), p - data);
+                }
+                state = stSeparator;
+                tokenSinceComma = true;
+            }
+            if (c == ',' || c == ';')
+            {
+                // two commas in a row enclose an empty value
+                if (!tokenSinceComma)
+                {
+                    sink.value(std::numeric_limits<double>::quiet_NaN(), p - data);
+                }
+                tokenSinceComma = false;
+            } else if (c == '\n')
+            {
+                tokenSinceComma = false;
+                sink.endOfLine(p - data);
+            }
+            continue;
+        }
+
+        const unsigned d = static_cast<unsigned>(c - '0');
+        switch (state)
+        {
+        case stSeparator:
+            beginToken();
+            if (d < 10)
+            {
+                addDigit(d);
+                state = stInteger;
+            } else if (c == '-' || c == '+')
+            {
+                negative = (c == '-');
+                state = stSign;
+            } else if (c == '.')
+            {
+                state = stFraction;
+            } else
+            {
+                state = stInvalid;
+            }
+            break;
+        case stSign:
+            if (d < 10)
+            {
+                addDigit(d);
+                state = stInteger;
+            } else if (c == '.')
+            {
+                state = stFraction;
+            } else
+            {
+                state = stInvalid;
+            }
+            break;
+        case stInteger:
+            if (d < 10)
+            {
+                addDigit(d);
+            } else if (c == '.')
+            {
+                state = stFraction;
+            } else if (c == 'e' || c == 'E')
+            {
+                state = stExponentSign;
+            } else
+            {
+                state = stInvalid;
+            }
+            break;
+        case stFraction:
+            if (d < 10)
+            {
+                addDigit(d);
+                --exponent;
+            } else if ((c == 'e' || c == 'E') && digits > 0)
+            {
+                state = stExponentSign;
+            } else
+            {
+                state = stInvalid;
+            }
+            break;
+        case stExponentSign:
+            if (d < 10)
+            {
+                expValue = d;
+                state = stExponent;
+            } else if (c == '-' || c == '+')
+            {
+                // the exponent sign must be followed by at least one digit
+                expNegative = (c == '-');
+                state = stExponentDigit;
+            } else
+            {
+                state = stInvalid;
+            }
+            break;
+        case stExponentDigit:
+            if (d < 10)
+            {
+                expValue = d;
+                state = stExponent;
+            } else
+            {
+                state = stInvalid;
+            }
+            break;
+        case stExponent:
+            if (d < 10)
+            {
+                if (expValue < 10000)
+                {
+                    expValue = expValue * 10 + d;
+                }
+            } else
+            {
+                state = stInvalid;
+            }
+            break;
+        case stInvalid:
+            break;
+        }
+    }
+}
+
+#endif // SAMPLEPARSER_H
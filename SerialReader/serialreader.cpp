@@ -0,0 +1,267 @@
+// Definition of methods for the SerialReader class
+
+#include "serialreader.h"
+#include "simulatedport.h"
+
+#include <QDateTime>
+#include <algorithm>
+
+
+// Constructor of the SerialReader class
+//
+// The serial port itself is only created in start(), so that it lives in the
+// thread the reader has been moved to. The capture writer runs its own thread
+SerialReader::SerialReader(RingBuffer<Sample> *ring, QObject *parent)
+    : QObject(parent)
+    , ring(ring)
+    , external(nullptr)
+    , simulated(nullptr)
+    , clockOrigin(0)
+    , byteTime(0)
+    , lastTime(0)
+    , receivedTime(0)
+    , parsedTime(0)
+    , frameChannels(0)
+    , dropped(0)
+    , overrun(0)
+    , recording(false)
+{
+    writer = new CaptureWriter(this);
+    QObject::connect(writer, &CaptureWriter::error, this, &SerialReader::recordingError);
+}
+
+// Destructor of the SerialReader class
+SerialReader::~SerialReader()
+{
+    writer->close();
+
+    // Before being destroyed, it closes the serial port (if it is opened)
+    if (external != nullptr && external->isOpen())
+    {
+        external->close();
+    }
+}
+
+quint64 SerialReader::droppedSamples() const
+{
+    return dropped.load(std::memory_order_relaxed);
+}
+
+quint64 SerialReader::overrunBytes() const
+{
+    return overrun.load(std::memory_order_relaxed);
+}
+
+// Slot that opens the serial port
+//
+// The port name, baud rate and decoder are given by the ui, all other serial port parameters are fixed.
+// Port names such as "sim:..." or "replay:..." open a SimulatedPort instead of a serial port.
+// Once opened, the port's readyRead() signal is connected to the slot readSerial()
+void SerialReader::start(const QString &portName, qint32 baudRate, const DecoderSettings &settings)
+{
+    stop();
+
+    QString error;
+    if (!processor.setChain(settings.processing, error))
+    {
+        emit errorOccurred(error);
+        return;
+    }
+
+    this->settings = settings;
+    decoder.reset(FrameDecoder::create(settings));
+    byteTime = baudRate > 0 ? 10 * Q_INT64_C(1000000000) / baudRate : 0;
+
+    if (SimulatedPort::isSimulated(portName))
+    {
+        simulated = new SimulatedPort(portName, baudRate, this);
+        external = simulated;
+    } else
+    {
+        QSerialPort *port = new QSerialPort(this);
+        port->setPortName(portName);
+        port->setBaudRate(baudRate);
+        port->setDataBits(QSerialPort::Data8);
+        port->setParity(QSerialPort::NoParity);
+        port->setStopBits(QSerialPort::OneStop);
+        port->setFlowControl(QSerialPort::NoFlowControl);
+        external = port;
+    }
+
+    if (!external->open(QIODevice::ReadOnly))
+    {
+        emit errorOccurred(external->errorString());
+        delete external;
+        external = nullptr;
+        simulated = nullptr;
+        return;
+    }
+
+    batch.clear();
+    lastTime = 0;
+    clockOrigin = QDateTime::currentMSecsSinceEpoch() - LatencyStats::now() / 1000000;
+    QObject::connect(external, SIGNAL(readyRead()), this, SLOT(readSerial()));
+    emit started();
+}
+
+// Slot that closes the serial port (if it is opened), and the capture file if recording
+//
+// The filters of the processing chain forget the signal of the port closed, so nothing of it
+// leaks into the frames read after a restart
+void SerialReader::stop()
+{
+    if (external == nullptr)
+    {
+        return;
+    }
+
+    stopRecording();
+    processor.reset();
+    if (external->isOpen())
+    {
+        external->close();
+    }
+    delete external;
+    external = nullptr;
+    simulated = nullptr;
+    emit stopped();
+}
+
+// Private method (slot) that reads the serial port every time new bytes arrive
+//
+// The port is drained into a fixed buffer that the decoder scans in place. Frames split between
+// two reads are completed on the next one, and no memory is allocated per sample.
+// Every frame is pushed with all of its channels (up to Sample::MaxChannels).
+//
+// Frames are timestamped with the monotonic clock when the bytes arrive. Since a single read
+// may contain many frames, their times can be interpolated: the last byte read arrived right now,
+// and each byte before it arrived one byte time earlier. Alternatively, a channel transmitted by
+// the device can be used as timestamp. In any case times never go backwards, so the data stays
+// sorted for the plot.
+//
+// With a processing chain, the frames of the read are processed together as a block before
+// being pushed (see processFrames()).
+void SerialReader::readSerial()
+{
+    receivedTime = LatencyStats::now();
+    const qint64 arrival = receivedTime;
+
+    qint64 size;
+    while ((size = external->read(serialData, sizeof(serialData))) > 0)
+    {
+        decoder->decode(serialData, size, batch);
+    }
+    parsedTime = LatencyStats::now();
+    if (simulated != nullptr)
+    {
+        overrun.store(simulated->overruns(), std::memory_order_relaxed);
+    }
+
+    const int frames = batch.frameCount();
+    const int tsChannel = settings.timeSource == DecoderSettings::DeviceTime ? settings.timestampChannel : -1;
+    double values[Sample::MaxChannels];
+    for (int i = 0; i < frames; ++i)
+    {
+        const double *frame = batch.frame(i);
+        qint64 time = arrival;
+        if (settings.timeSource == DecoderSettings::InterpolatedTime)
+        {
+            time = arrival - (batch.consumed - batch.frameEnd(i)) * byteTime;
+        } else if (tsChannel >= 0 && tsChannel < batch.channels)
+        {
+            time = qint64(frame[tsChannel] * settings.timestampScale * 1e9);
+        }
+        time = qMax(time, lastTime);
+        lastTime = time;
+
+        if (tsChannel >= 0 && tsChannel < batch.channels)
+        {
+            // the timestamp channel is not plotted
+            int count = 0;
+            for (int c = 0; c < batch.channels && count < Sample::MaxChannels; ++c)
+            {
+                if (c != tsChannel)
+                {
+                    values[count++] = frame[c];
+                }
+            }
+            acceptFrame(time, values, count);
+        } else
+        {
+            acceptFrame(time, frame, batch.channels);
+        }
+    }
+    batch.clear();
+    processFrames();
+}
+
+// Slot that starts recording to fileName, until stopRecording() is called or the port is closed
+void SerialReader::startRecording(const QString &fileName)
+{
+    recording = writer->open(fileName, clockOrigin);
+    if (!recording)
+    {
+        emit recordingError(writer->errorString());
+    }
+}
+
+// Slot that stops recording and closes the capture file
+void SerialReader::stopRecording()
+{
+    recording = false;
+    writer->close();
+}
+
+// Private method that pushes a decoded frame, or keeps it for processFrames() with a processing chain
+void SerialReader::acceptFrame(qint64 time, const double *values, int count)
+{
+    if (processor.isEmpty())
+    {
+        pushSample(time, values, count);
+        return;
+    }
+    frameTimes.push_back(time);
+    frameValues.insert(frameValues.end(), values, values + count);
+    frameChannels = count;
+}
+
+// Private method that runs the frames kept by acceptFrame() through the processing chain and
+// pushes the frames it outputs. Processing counts as part of decoding for the latency statistics
+void SerialReader::processFrames()
+{
+    if (frameTimes.empty())
+    {
+        return;
+    }
+    processor.process(frameTimes.data(), frameValues.data(), int(frameTimes.size()), frameChannels);
+    frameTimes.clear();
+    frameValues.clear();
+    parsedTime = LatencyStats::now();
+
+    processedFrame.resize(std::size_t(processor.channelCount()));
+    for (int i = 0; i < processor.frameCount(); ++i)
+    {
+        processor.frame(i, processedFrame.data());
+        pushSample(processor.time(i), processedFrame.data(), processor.channelCount());
+    }
+}
+
+// Private method that hands a sample over to the GUI thread and, in record mode, to the capture writer
+void SerialReader::pushSample(qint64 time, const double *values, int count)
+{
+    if (recording)
+    {
+        writer->append(time, values, count);
+    }
+
+    Sample sample;
+    sample.time = time;
+    sample.received = receivedTime;
+    sample.parsed = parsedTime;
+    sample.channels = qMin(count, int(Sample::MaxChannels));
+    std::copy(values, values + sample.channels, sample.values);
+    if (!ring->push(sample))
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef SERIALREADER_H
+#define SERIALREADER_H
+
+#include <QObject>
+#include <QSerialPort>
+#include <QString>
+#include <QScopedPointer>
+#include <atomic>
+
+#include "ringbuffer.h"
+#include "sample.h"
+#include "capturewriter.h"
+#include "framedecoder.h"
+#include "latencystats.h"
+#include "signalprocessor.h"
+
+class SimulatedPort;
+
+// Definition of the class that acquires data from the serial port
+//
+// An instance of this class is meant to be moved to its own QThread: it owns the
+// QSerialPort (or the SimulatedPort standing in for it, see simulatedport.h),
+// drains it as soon as bytes arrive, decodes them into frames with the
+// FrameDecoder selected in the ui, optionally runs them through a SignalProcessor
+// (filters, decimation, derived channels) and pushes samples into a lock-free ring buffer.
+// In record mode, samples are also appended to a capture file from this thread, so
+// recording never depends on the GUI keeping up. The GUI thread pops them from the ring
+// at its own pace, so a slow replot can never hold back the serial port.
+class SerialReader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SerialReader(RingBuffer<Sample> *ring, QObject *parent = nullptr);
+    ~SerialReader();
+
+    // Number of samples lost because the ring buffer was full (can be read from any thread)
+    quint64 droppedSamples() const;
+
+    // Number of bytes a simulated port discarded because its link couldn't keep up (0 for serial
+    // ports, can be read from any thread)
+    quint64 overrunBytes() const;
+
+public slots:
+    void start(const QString &portName, qint32 baudRate, const DecoderSettings &settings);
+
+    void stop();
+
+    // Starts (or stops) recording every acquired sample to a capture file
+    void startRecording(const QString &fileName);
+
+    void stopRecording();
+
+signals:
+    void started();
+
+    void stopped();
+
+    void errorOccurred(const QString &message);
+
+    void recordingError(const QString &message);
+
+private slots:
+    void readSerial();
+
+private:
+    void acceptFrame(qint64 time, const double *values, int count);
+
+    void processFrames();
+
+    void pushSample(qint64 time, const double *values, int count);
+
+    RingBuffer<Sample> *ring;
+
+    // The serial port, or a simulated one (then also pointed to by simulated)
+    QIODevice *external;
+
+    SimulatedPort *simulated;
+
+    // Fixed buffer the port is drained into, reused on every read
+    char serialData[16384];
+
+    QScopedPointer<FrameDecoder> decoder;
+
+    DecoderSettings settings;
+
+    // Wall clock time (ms since epoch) corresponding to time 0 of the monotonic clock samples are
+    // timestamped with (LatencyStats::now(), shared by all readers so that all ports have the same time axis)
+    qint64 clockOrigin;
+
+    // Time it takes to transmit a byte at the current baud rate (8 data bits, 1 start and 1 stop bit)
+    qint64 byteTime;
+
+    qint64 lastTime;
+
+    // LatencyStats::now() when the bytes being decoded arrived and when decoding finished
+    qint64 receivedTime;
+
+    qint64 parsedTime;
+
+    // Frames decoded from the last read, reused on every read
+    FrameBatch batch;
+
+    // Processing chain, and the frames of the last read waiting to be processed (their times,
+    // and their values one frame after the other) and a processed frame (all reused on every read)
+    SignalProcessor processor;
+
+    std::vector<qint64> frameTimes;
+
+    std::vector<double> frameValues;
+
+    int frameChannels;
+
+    std::vector<double> processedFrame;
+
+    std::atomic<quint64> dropped;
+
+    std::atomic<quint64> overrun;
+
+    CaptureWriter *writer;
+
+    bool recording;
+};
+
+#endif // SERIALREADER_H
@@ -0,0 +1,534 @@
+// Definition of methods for the SignalProcessor class and its processing stages
+
+#include "signalprocessor.h"
+
+#include <QStringList>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+
+// Taps of the anti-aliasing filter of decimation, per unit of the factor
+const int decimationTapsPerFactor = 8;
+
+// Most taps of a filter, and largest decimation factor
+const int maxTaps = 4097;
+
+const int maxDecimation = 512;
+
+const double notANumber = std::numeric_limits<double>::quiet_NaN();
+
+// Parses text as comma separated numbers
+bool parseNumbers(const QString &text, std::vector<double> &numbers)
+{
+    numbers.clear();
+    if (text.trimmed().isEmpty())
+    {
+        return true;
+    }
+    for (const QString &item : text.split(','))
+    {
+        bool ok = false;
+        const double value = item.trimmed().toDouble(&ok);
+        if (!ok || !std::isfinite(value))
+        {
+            return false;
+        }
+        numbers.push_back(value);
+    }
+    return true;
+}
+
+// Creates the stage called name with numeric arguments, nullptr if they are not valid for it
+ProcessingStage *createStage(const QString &name, const QVector<int> &channels, const std::vector<double> &numbers)
+{
+    const std::size_t count = numbers.size();
+    if (name == "scale" && (count == 1 || count == 2))
+    {
+        return new ScaleStage(channels, numbers[0], count == 2 ? numbers[1] : 0.0);
+    } else if (name == "ma" && count == 1 && numbers[0] >= 1 && numbers[0] <= maxTaps)
+    {
+        return new MovingAverageStage(channels, int(numbers[0]));
+    } else if ((name == "lowpass" || name == "highpass") && count == 1 && numbers[0] > 0 && numbers[0] < 0.5)
+    {
+        return BiquadStage::butterworth(channels, numbers[0], name == "highpass");
+    } else if (name == "iir" && count == 5)
+    {
+        return new BiquadStage(channels, numbers[0], numbers[1], numbers[2], numbers[3], numbers[4]);
+    } else if (name == "fir" && count >= 1 && count <= std::size_t(maxTaps))
+    {
+        return new FirStage(channels, numbers);
+    } else if (name == "decimate" && count == 1 && numbers[0] >= 1 && numbers[0] <= maxDecimation && channels.isEmpty())
+    {
+        return new DecimateStage(int(numbers[0]));
+    }
+    return nullptr;
+}
+
+}
+
+// Constructor of the ScaleStage class
+ScaleStage::ScaleStage(const QVector<int> &channels, double gain, double offset)
+    : ProcessingStage(channels)
+    , gain(gain)
+    , offset(offset)
+{
+}
+
+void ScaleStage::process(SignalBlock &block)
+{
+    for (int c = 0; c < block.channelCount(); ++c)
+    {
+        if (!applies(c))
+        {
+            continue;
+        }
+        double *x = block.columns[std::size_t(c)].data();
+        const int frames = block.frameCount();
+        for (int i = 0; i < frames; ++i)
+        {
+            x[i] = gain * x[i] + offset;
+        }
+    }
+}
+
+// Constructor of the FirStage class
+FirStage::FirStage(const QVector<int> &channels, const std::vector<double> &coefficients)
+    : ProcessingStage(channels)
+    , h(coefficients)
+{
+}
+
+std::vector<double> FirStage::lowPass(int taps, double cutoff)
+{
+    std::vector<double> coefficients(std::size_t(qMax(taps, 1)));
+    const double middle = 0.5 * (coefficients.size() - 1);
+    double sum = 0;
+    for (std::size_t k = 0; k < coefficients.size(); ++k)
+    {
+        const double x = double(k) - middle;
+        const double sinc = x == 0 ? 2 * cutoff : std::sin(2 * pi * cutoff * x) / (pi * x);
+        const double w = coefficients.size() > 1 ? 2 * pi * double(k) / double(coefficients.size() - 1) : 0;
+        coefficients[k] = sinc * (0.42 - 0.5 * std::cos(w) + 0.08 * std::cos(2 * w));
+        sum += coefficients[k];
+    }
+    for (double &coefficient : coefficients)
+    {
+        coefficient /= sum;
+    }
+    return coefficients;
+}
+
+const double *FirStage::extend(int channel, const std::vector<double> &column)
+{
+    const std::size_t kept = h.size() - 1;
+    if (history.size() <= std::size_t(channel))
+    {
+        history.resize(std::size_t(channel) + 1);
+    }
+    std::vector<double> &past = history[std::size_t(channel)];
+    if (past.size() != kept)
+    {
+        past.assign(kept, column.front());
+    }
+
+    scratch.resize(kept + column.size());
+    std::copy(past.begin(), past.end(), scratch.begin());
+    std::copy(column.begin(), column.end(), scratch.begin() + qint64(kept));
+    std::copy(scratch.end() - qint64(kept), scratch.end(), past.begin());
+    return scratch.data();
+}
+
+void FirStage::process(SignalBlock &block)
+{
+    const int frames = block.frameCount();
+    if (frames == 0)
+    {
+        return;
+    }
+    const int taps = int(h.size());
+    for (int c = 0; c < block.channelCount(); ++c)
+    {
+        if (!applies(c))
+        {
+            continue;
+        }
+        std::vector<double> &column = block.columns[std::size_t(c)];
+        const double *x = extend(c, column) + taps - 1;
+        double *y = column.data();
+        std::fill(y, y + frames, 0.0);
+        for (int k = 0; k < taps; ++k)
+        {
+            const double coefficient = h[std::size_t(k)];
+            const double *xk = x - k;
+            for (int i = 0; i < frames; ++i)
+            {
+                y[i] += coefficient * xk[i];
+            }
+        }
+    }
+}
+
+// Constructor of the MovingAverageStage class
+MovingAverageStage::MovingAverageStage(const QVector<int> &channels, int n)
+    : FirStage(channels, std::vector<double>(std::size_t(n), 1.0 / n))
+{
+}
+
+// Public method that filters the block with a running sum, whatever the length of the average
+void MovingAverageStage::process(SignalBlock &block)
+{
+    const int frames = block.frameCount();
+    if (frames == 0)
+    {
+        return;
+    }
+    const int n = int(h.size());
+    for (int c = 0; c < block.channelCount(); ++c)
+    {
+        if (!applies(c))
+        {
+            continue;
+        }
+        std::vector<double> &column = block.columns[std::size_t(c)];
+        const double *x = extend(c, column);
+        double *y = column.data();
+        double sum = 0;
+        for (int k = 0; k < n - 1; ++k)
+        {
+            sum += x[k];
+        }
+        for (int i = 0; i < frames; ++i)
+        {
+            sum += x[i + n - 1];
+            y[i] = sum / n;
+            sum -= x[i];
+        }
+    }
+}
+
+// Constructor of the DecimateStage class
+//
+// The cutoff of the anti-aliasing filter is a little below the new Nyquist frequency (0.5 / factor),
+// so that the transition band of the filter is mostly attenuated before it aliases
+DecimateStage::DecimateStage(int factor)
+    : FirStage(QVector<int>(), lowPass(qMin(decimationTapsPerFactor * factor + 1, maxTaps), 0.4 / factor))
+    , factor(factor)
+    , phase(0)
+{
+}
+
+void DecimateStage::process(SignalBlock &block)
+{
+    const int frames = block.frameCount();
+    if (frames == 0)
+    {
+        return;
+    }
+    int kept = 0;
+    for (int i = phase; i < frames; i += factor)
+    {
+        block.times[std::size_t(kept++)] = block.times[std::size_t(i)];
+    }
+
+    const int taps = int(h.size());
+    for (int c = 0; c < block.channelCount(); ++c)
+    {
+        std::vector<double> &column = block.columns[std::size_t(c)];
+        const double *x = extend(c, column) + taps - 1;
+        output.resize(std::size_t(kept));
+        for (int j = 0; j < kept; ++j)
+        {
+            const double *xi = x + phase + j * factor;
+            double sum = 0;
+            for (int k = 0; k < taps; ++k)
+            {
+                sum += h[std::size_t(k)] * xi[-k];
+            }
+            output[std::size_t(j)] = sum;
+        }
+        column.assign(output.begin(), output.end());
+    }
+    block.times.resize(std::size_t(kept));
+    phase = phase + kept * factor - frames;
+}
+
+// Constructor of the BiquadStage class
+BiquadStage::BiquadStage(const QVector<int> &channels, double b0, double b1, double b2, double a1, double a2)
+    : ProcessingStage(channels)
+    , b0(b0)
+    , b1(b1)
+    , b2(b2)
+    , a1(a1)
+    , a2(a2)
+{
+}
+
+// Coefficients from the Audio EQ Cookbook (R. Bristow-Johnson), with Q = 1 / sqrt(2)
+BiquadStage *BiquadStage::butterworth(const QVector<int> &channels, double cutoff, bool highPass)
+{
+    const double w0 = 2 * pi * cutoff;
+    const double alpha = std::sin(w0) / std::sqrt(2.0);
+    const double cosw0 = std::cos(w0);
+    const double a0 = 1 + alpha;
+    const double b1 = highPass ? -(1 + cosw0) : 1 - cosw0;
+    const double b0 = highPass ? -b1 / 2 : b1 / 2;
+    return new BiquadStage(channels, b0 / a0, b1 / a0, b0 / a0, -2 * cosw0 / a0, (1 - alpha) / a0);
+}
+
+void BiquadStage::process(SignalBlock &block)
+{
+    const int frames = block.frameCount();
+    if (frames == 0)
+    {
+        return;
+    }
+    state.resize(std::size_t(block.channelCount()));
+    started.resize(std::size_t(block.channelCount()), false);
+    for (int c = 0; c < block.channelCount(); ++c)
+    {
+        if (!applies(c))
+        {
+            continue;
+        }
+        double *x = block.columns[std::size_t(c)].data();
+        double s1 = state[std::size_t(c)].first;
+        double s2 = state[std::size_t(c)].second;
+        if (!started[std::size_t(c)])
+        {
+            // steady state of a constant input x[0]
+            const double denominator = 1 + a1 + a2;
+            const double y = denominator != 0 ? (b0 + b1 + b2) / denominator * x[0] : 0;
+            s2 = b2 * x[0] - a2 * y;
+            s1 = b1 * x[0] - a1 * y + s2;
+            started[std::size_t(c)] = true;
+        }
+        for (int i = 0; i < frames; ++i)
+        {
+            const double input = x[i];
+            const double y = b0 * input + s1;
+            s1 = b1 * input - a1 * y + s2;
+            s2 = b2 * input - a2 * y;
+            x[i] = y;
+        }
+        state[std::size_t(c)] = std::make_pair(s1, s2);
+    }
+}
+
+// Constructor of the DeriveStage class
+DeriveStage::DeriveStage(const QVector<QPair<int, double> > &terms, double constant)
+    : terms(terms)
+    , constant(constant)
+{
+}
+
+bool DeriveStage::parse(const QString &text, QVector<QPair<int, double> > &terms, double &constant)
+{
+    terms.clear();
+    constant = 0;
+
+    QString expression = text;
+    expression.remove(' ');
+    if (expression.isEmpty())
+    {
+        return false;
+    }
+
+    // splits the expression at every sign that is not part of a number (1e-3) or follows '*'
+    QStringList items;
+    int begin = 0;
+    for (int i = 1; i <= expression.size(); ++i)
+    {
+        if (i == expression.size()
+            || ((expression[i] == '+' || expression[i] == '-')
+                && expression[i - 1].toLower() != 'e' && expression[i - 1] != '*'))
+        {
+            items.append(expression.mid(begin, i - begin));
+            begin = i;
+        }
+    }
+
+    for (QString item : items)
+    {
+        double sign = 1;
+        if (item.startsWith('+') || item.startsWith('-'))
+        {
+            sign = item.startsWith('-') ? -1 : 1;
+            item.remove(0, 1);
+        }
+        const int channel = item.indexOf('c', 0, Qt::CaseInsensitive);
+        bool ok = false;
+        if (channel < 0)
+        {
+            constant += sign * item.toDouble(&ok);
+            if (!ok)
+            {
+                return false;
+            }
+            continue;
+        }
+
+        double weight = 1;
+        if (channel > 0)
+        {
+            if (item[channel - 1] != '*')
+            {
+                return false;
+            }
+            weight = item.left(channel - 1).toDouble(&ok);
+            if (!ok)
+            {
+                return false;
+            }
+        }
+        const int index = item.mid(channel + 1).toInt(&ok);
+        if (!ok || index < 1)
+        {
+            return false;
+        }
+        terms.append(qMakePair(index - 1, sign * weight));
+    }
+    return true;
+}
+
+// Public method that appends the derived channel to the block. A channel the frames don't have makes it NaN
+void DeriveStage::process(SignalBlock &block)
+{
+    const int frames = block.frameCount();
+    std::vector<double> derived(std::size_t(frames), constant);
+    double *y = derived.data();
+    for (const QPair<int, double> &term : terms)
+    {
+        if (term.first >= block.channelCount())
+        {
+            std::fill(derived.begin(), derived.end(), notANumber);
+            break;
+        }
+        const double *x = block.columns[std::size_t(term.first)].data();
+        const double weight = term.second;
+        for (int i = 0; i < frames; ++i)
+        {
+            y[i] += weight * x[i];
+        }
+    }
+    block.columns.push_back(std::move(derived));
+}
+
+// Constructor of the SignalProcessor class
+SignalProcessor::SignalProcessor()
+{
+}
+
+// Destructor of the SignalProcessor class
+SignalProcessor::~SignalProcessor()
+{
+}
+
+bool SignalProcessor::setChain(const QString &text, QString &error)
+{
+    stages.clear();
+    error.clear();
+
+    for (const QString &item : text.split(';'))
+    {
+        const QString spec = item.trimmed();
+        if (spec.isEmpty())
+        {
+            continue;
+        }
+
+        const int colon = spec.indexOf(':');
+        QString name = (colon < 0 ? spec : spec.left(colon)).trimmed().toLower();
+        const QString arguments = colon < 0 ? QString() : spec.mid(colon + 1).trimmed();
+
+        QVector<int> channels;
+        const int at = name.indexOf('@');
+        if (at >= 0)
+        {
+            for (const QString &channel : name.mid(at + 1).split(','))
+            {
+                bool ok = false;
+                const int index = channel.trimmed().toInt(&ok);
+                if (!ok || index < 1)
+                {
+                    error = QString("Invalid channel '%1' in '%2'").arg(channel.trimmed(), spec);
+                    stages.clear();
+                    return false;
+                }
+                channels.append(index - 1);
+            }
+            name = name.left(at).trimmed();
+        }
+
+        ProcessingStage *stage = nullptr;
+        if (name == "derive")
+        {
+            QVector<QPair<int, double> > terms;
+            double constant = 0;
+            if (channels.isEmpty() && DeriveStage::parse(arguments, terms, constant))
+            {
+                stage = new DeriveStage(terms, constant);
+            }
+        } else
+        {
+            std::vector<double> numbers;
+            if (parseNumbers(arguments, numbers))
+            {
+                stage = createStage(name, channels, numbers);
+            }
+        }
+
+        if (stage == nullptr)
+        {
+            error = QString("Invalid processing stage '%1'").arg(spec);
+            stages.clear();
+            return false;
+        }
+        stages.emplace_back(stage);
+    }
+    return true;
+}
+
+void SignalProcessor::reset()
+{
+    for (const std::unique_ptr<ProcessingStage> &stage : stages)
+    {
+        stage->reset();
+    }
+}
+
+// Public method that runs the frames through every stage
+//
+// The frames are transposed to columns here, and back by frame(), so that every stage loops
+// over the contiguous samples of a channel
+void SignalProcessor::process(const qint64 *times, const double *values, int frames, int channels)
+{
+    block.times.assign(times, times + frames);
+    block.columns.resize(std::size_t(qMax(channels, 0)));
+    for (int c = 0; c < channels; ++c)
+    {
+        std::vector<double> &column = block.columns[std::size_t(c)];
+        column.resize(std::size_t(frames));
+        for (int i = 0; i < frames; ++i)
+        {
+            column[std::size_t(i)] = values[i * channels + c];
+        }
+    }
+
+    for (const std::unique_ptr<ProcessingStage> &stage : stages)
+    {
+        stage->process(block);
+    }
+}
+
+void SignalProcessor::frame(int index, double *values) const
+{
+    for (int c = 0; c < block.channelCount(); ++c)
+    {
+        values[c] = block.columns[std::size_t(c)][std::size_t(index)];
+    }
+}
@@ -0,0 +1,204 @@
+#ifndef SIGNALPROCESSOR_H
+#define SIGNALPROCESSOR_H
+
+#include <QtGlobal>
+#include <QPair>
+#include <QString>
+#include <QVector>
+#include <memory>
+#include <vector>
+
+// Frames being processed, stored channel by channel (one column per channel) so that every
+// stage runs over contiguous samples
+struct SignalBlock
+{
+    int frameCount() const { return int(times.size()); }
+
+    int channelCount() const { return int(columns.size()); }
+
+    std::vector<qint64> times;
+
+    std::vector<std::vector<double> > columns;
+};
+
+// Interface of all processing stages
+//
+// A stage is fed the frames decoded from the serial port block after block, and transforms them
+// in place. Filters keep the last samples of every channel (their state) from one block to the next,
+// so the output is the same however the frames are split in blocks. Stages that work per channel
+// apply to the channels given (0-based), or to all of them if none is given.
+class ProcessingStage
+{
+public:
+    explicit ProcessingStage(const QVector<int> &channels = QVector<int>()) : channels(channels) {}
+
+    virtual ~ProcessingStage() {}
+
+    virtual void process(SignalBlock &block) = 0;
+
+    // Forgets the state of the filters
+    virtual void reset() {}
+
+protected:
+    bool applies(int channel) const { return channels.isEmpty() || channels.contains(channel); }
+
+    QVector<int> channels;
+};
+
+// y = gain * x + offset
+class ScaleStage : public ProcessingStage
+{
+public:
+    ScaleStage(const QVector<int> &channels, double gain, double offset);
+
+    void process(SignalBlock &block) override;
+
+private:
+    double gain;
+
+    double offset;
+};
+
+// Finite impulse response filter: y[i] = sum of h[k] * x[i - k]
+//
+// Every channel keeps its last taps - 1 samples (the first sample of a channel stands for the ones
+// before it, so filters start without a transient). The output is computed tap by tap over the
+// whole block: a plain loop over contiguous samples, which an optimizing compiler may vectorize
+// (no intrinsics are used)
+class FirStage : public ProcessingStage
+{
+public:
+    FirStage(const QVector<int> &channels, const std::vector<double> &coefficients);
+
+    void process(SignalBlock &block) override;
+
+    void reset() override { history.clear(); }
+
+    // Coefficients of a low-pass filter (windowed sinc, Blackman window) with the given number of
+    // taps and cutoff frequency (as a fraction of the sampling rate, up to 0.5), with unity DC gain
+    static std::vector<double> lowPass(int taps, double cutoff);
+
+protected:
+    // Prepends the history of channel to column into scratch, and keeps the last samples as history
+    const double *extend(int channel, const std::vector<double> &column);
+
+    std::vector<double> h;
+
+    std::vector<std::vector<double> > history;
+
+    std::vector<double> scratch;
+
+    std::vector<double> output;
+};
+
+// Moving average of the last n samples
+class MovingAverageStage : public FirStage
+{
+public:
+    MovingAverageStage(const QVector<int> &channels, int n);
+
+    void process(SignalBlock &block) override;
+};
+
+// Anti-aliased decimation: all channels are low-pass filtered below the new Nyquist frequency and
+// one frame out of factor is kept (with its time). Only the frames kept are filtered
+class DecimateStage : public FirStage
+{
+public:
+    explicit DecimateStage(int factor);
+
+    void process(SignalBlock &block) override;
+
+    void reset() override { FirStage::reset(); phase = 0; }
+
+private:
+    int factor;
+
+    // Frames to skip before the next one kept
+    int phase;
+};
+
+// Second order infinite impulse response filter (biquad), in transposed direct form II:
+// y[i] = b0 x[i] + b1 x[i-1] + b2 x[i-2] - a1 y[i-1] - a2 y[i-2]
+//
+// The recursion runs sample by sample, one channel after the other (every output depends on the
+// previous one), which costs five multiplications per sample. Filters start in the steady state
+// of the first sample, without a transient
+class BiquadStage : public ProcessingStage
+{
+public:
+    BiquadStage(const QVector<int> &channels, double b0, double b1, double b2, double a1, double a2);
+
+    void process(SignalBlock &block) override;
+
+    void reset() override { state.clear(); started.clear(); }
+
+    // Butterworth low-pass or high-pass filter with cutoff given as a fraction of the sampling rate
+    static BiquadStage *butterworth(const QVector<int> &channels, double cutoff, bool highPass);
+
+private:
+    double b0, b1, b2, a1, a2;
+
+    // s1 and s2 of every channel
+    std::vector<std::pair<double, double> > state;
+
+    std::vector<bool> started;
+};
+
+// Derived channel appended to the frames: constant + sum of weight * channel
+class DeriveStage : public ProcessingStage
+{
+public:
+    DeriveStage(const QVector<QPair<int, double> > &terms, double constant);
+
+    void process(SignalBlock &block) override;
+
+    // Parses a linear combination of channels (c1, c2... being the channels), e.g. "c1-c2" or "0.5*c1+2"
+    static bool parse(const QString &text, QVector<QPair<int, double> > &terms, double &constant);
+
+private:
+    QVector<QPair<int, double> > terms;
+
+    double constant;
+};
+
+// Definition of the class that applies a chain of processing stages to the decoded frames
+//
+// The chain is written as stages separated by ';', each one being name[@channels][:arguments]
+// with channels given as comma separated numbers starting at 1 (see the README), e.g.
+// "lowpass@1,2:0.05; decimate:4; derive:c1-c2". Frames are processed in blocks (all the frames
+// of a read of the serial port), converted to columns once so that every stage works on
+// contiguous samples
+class SignalProcessor
+{
+public:
+    SignalProcessor();
+    ~SignalProcessor();
+
+    // Builds the chain described by text. Returns false (with a message in error, and no stages) if it is not valid
+    bool setChain(const QString &text, QString &error);
+
+    bool isEmpty() const { return stages.empty(); }
+
+    void reset();
+
+    // Processes frames frames (channels values each, one frame after the other) taken at times.
+    // The frames produced (fewer when decimating) can then be read with frameCount(), time() and frame()
+    void process(const qint64 *times, const double *values, int frames, int channels);
+
+    int frameCount() const { return block.frameCount(); }
+
+    int channelCount() const { return block.channelCount(); }
+
+    qint64 time(int index) const { return block.times[std::size_t(index)]; }
+
+    // Copies the channelCount() values of frame index to values
+    void frame(int index, double *values) const;
+
+private:
+    std::vector<std::unique_ptr<ProcessingStage> > stages;
+
+    SignalBlock block;
+};
+
+#endif // SIGNALPROCESSOR_H
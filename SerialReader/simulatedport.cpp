@@ -0,0 +1,261 @@
+// Definition of methods for the SimulatedPort class
+
+#include "simulatedport.h"
+#include "numberformat.h"
+#include "sample.h"
+
+#include <QStringList>
+#include <QtMath>
+#include <cmath>
+#include <limits>
+
+
+// Constructor of the SimulatedPort class
+SimulatedPort::SimulatedPort(const QString &portName, qint32 baudRate, QObject *parent)
+    : QIODevice(parent)
+    , portName(portName)
+    , baudRate(baudRate)
+    , backlogStart(0)
+    , pendingStart(0)
+    , framesGenerated(0)
+    , bytesTransmitted(0)
+    , overrun(0)
+    , state(1)
+{
+    timer = new QTimer(this);
+    timer->setTimerType(Qt::PreciseTimer);
+    QObject::connect(timer, &QTimer::timeout, this, &SimulatedPort::tick);
+}
+
+// Destructor of the SimulatedPort class
+SimulatedPort::~SimulatedPort()
+{
+    close();
+}
+
+bool SimulatedPort::isSimulated(const QString &portName)
+{
+    return portName == "sim" || portName.startsWith("sim:") || portName.startsWith("replay:");
+}
+
+bool SimulatedPort::parse(const QString &portName, Settings &settings)
+{
+    settings.replayFile.clear();
+    settings.channels = 2;
+    settings.frameRate = 1000;
+    settings.burstInterval = 1;
+    settings.seed = 1;
+
+    if (portName.startsWith("replay:"))
+    {
+        settings.replayFile = portName.mid(7);
+        return !settings.replayFile.isEmpty();
+    }
+    if (!isSimulated(portName))
+    {
+        return false;
+    }
+
+    for (const QString &option : portName.mid(4).split(','))
+    {
+        if (option.trimmed().isEmpty())
+        {
+            continue;
+        }
+        const QString key = option.section('=', 0, 0).trimmed();
+        bool ok = false;
+        if (key == "channels")
+        {
+            settings.channels = option.section('=', 1).toInt(&ok);
+            ok = ok && settings.channels >= 1 && settings.channels <= Sample::MaxChannels;
+        } else if (key == "rate")
+        {
+            settings.frameRate = option.section('=', 1).toDouble(&ok);
+            ok = ok && settings.frameRate > 0;
+        } else if (key == "burst")
+        {
+            settings.burstInterval = option.section('=', 1).toInt(&ok);
+            ok = ok && settings.burstInterval >= 1 && settings.burstInterval <= 1000;
+        } else if (key == "seed")
+        {
+            settings.seed = option.section('=', 1).toUInt(&ok);
+        }
+        if (!ok)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Public method that starts transmitting. Only QIODevice::ReadOnly is supported
+bool SimulatedPort::open(OpenMode mode)
+{
+    if (mode & WriteOnly)
+    {
+        setErrorString("The simulated port is read-only");
+        return false;
+    }
+    if (!parse(portName, settings))
+    {
+        setErrorString("Invalid simulated port: " + portName);
+        return false;
+    }
+    if (!settings.replayFile.isEmpty())
+    {
+        if (baudRate <= 0)
+        {
+            setErrorString("Replaying needs a baud rate");
+            return false;
+        }
+        replay.setFileName(settings.replayFile);
+        if (!replay.open(QFile::ReadOnly))
+        {
+            setErrorString(replay.errorString());
+            return false;
+        }
+    }
+
+    backlog.clear();
+    backlogStart = 0;
+    pending.clear();
+    pendingStart = 0;
+    framesGenerated = 0;
+    bytesTransmitted = 0;
+    overrun = 0;
+    state = settings.seed != 0 ? settings.seed : 1;
+
+    QIODevice::open(mode | Unbuffered);
+    clock.start();
+    timer->start(settings.burstInterval);
+    return true;
+}
+
+void SimulatedPort::close()
+{
+    timer->stop();
+    replay.close();
+    backlog.clear();
+    pending.clear();
+    QIODevice::close();
+}
+
+qint64 SimulatedPort::bytesAvailable() const
+{
+    return pending.size() - pendingStart + QIODevice::bytesAvailable();
+}
+
+qint64 SimulatedPort::readData(char *data, qint64 maxSize)
+{
+    const int count = int(qMin(maxSize, qint64(pending.size() - pendingStart)));
+    std::copy(pending.constData() + pendingStart, pending.constData() + pendingStart + count, data);
+    pendingStart += count;
+    if (pendingStart == pending.size())
+    {
+        pending.resize(0);
+        pendingStart = 0;
+    }
+    return count;
+}
+
+qint64 SimulatedPort::writeData(const char *, qint64)
+{
+    return -1;
+}
+
+// Private method (slot) called every burst interval
+//
+// It generates the frames due since the port was opened, and transmits as many bytes as the link
+// could have carried meanwhile. An idle link doesn't save up capacity for later
+void SimulatedPort::tick()
+{
+    const qint64 elapsed = clock.nsecsElapsed();
+    qint64 budget = std::numeric_limits<int>::max();
+    if (baudRate > 0)
+    {
+        budget = qMin(budget, qint64(double(elapsed) * baudRate / 10 / 1e9) - bytesTransmitted);
+    }
+
+    qint64 sent = 0;
+    if (replay.isOpen())
+    {
+        budget = qMin(budget, Q_INT64_C(1) << 20);
+        const int offset = pending.size();
+        pending.resize(offset + int(budget));
+        while (sent < budget)
+        {
+            const qint64 size = replay.read(pending.data() + offset + sent, budget - sent);
+            if (size <= 0)
+            {
+                // from the start again, unless the file is empty
+                if (replay.size() == 0 || !replay.seek(0))
+                {
+                    break;
+                }
+                continue;
+            }
+            sent += size;
+        }
+        pending.resize(offset + int(sent));
+    } else
+    {
+        const qint64 due = qint64(double(elapsed) * settings.frameRate / 1e9);
+        // after a stall, at most one second worth of frames is generated at once
+        framesGenerated = qMax(framesGenerated, due - qint64(std::ceil(settings.frameRate)));
+        synthesize(due - framesGenerated);
+
+        sent = qMin(budget, qint64(backlog.size() - backlogStart));
+        pending.append(backlog.constData() + backlogStart, int(sent));
+        backlogStart += int(sent);
+
+        // bytes the link can't carry within a second are lost
+        const qint64 limit = baudRate > 0 ? qMax(qint64(baudRate / 10), Q_INT64_C(1024)) : std::numeric_limits<int>::max();
+        if (backlog.size() - backlogStart > limit)
+        {
+            overrun += quint64(backlog.size() - backlogStart - limit);
+            backlogStart = backlog.size() - int(limit);
+        }
+        if (backlogStart > backlog.size() / 2)
+        {
+            backlog.remove(0, backlogStart);
+            backlogStart = 0;
+        }
+    }
+
+    bytesTransmitted += sent;
+    if (baudRate > 0 && sent < budget)
+    {
+        bytesTransmitted = qint64(double(elapsed) * baudRate / 10 / 1e9);
+    }
+    if (sent > 0)
+    {
+        emit readyRead();
+    }
+}
+
+// Private method that appends frames lines of comma separated values to the backlog.
+// Channel c is a sine of c + 1 Hz plus 10% of uniform noise
+void SimulatedPort::synthesize(qint64 frames)
+{
+    char text[40];
+    for (qint64 i = 0; i < frames; ++i, ++framesGenerated)
+    {
+        const double t = framesGenerated / settings.frameRate;
+        for (int c = 0; c < settings.channels; ++c)
+        {
+            const double value = std::sin(2 * M_PI * (c + 1) * t) + 0.1 * noise();
+            int size = formatDouble(value, 6, text);
+            text[size++] = c + 1 < settings.channels ? ',' : '\n';
+            backlog.append(text, size);
+        }
+    }
+}
+
+// Private method that returns a pseudo-random number in [-1, 1) (xorshift32)
+double SimulatedPort::noise()
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state / 2147483648.0 - 1.0;
+}
@@ -0,0 +1,104 @@
+#ifndef SIMULATEDPORT_H
+#define SIMULATEDPORT_H
+
+#include <QIODevice>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QByteArray>
+#include <QString>
+
+// Definition of the class that stands in for a serial port, to drive the acquisition pipeline
+// without hardware (e.g. for load tests on a headless machine)
+//
+// It is a read-only sequential QIODevice selected through the port name:
+//   sim[:channels=N,rate=HZ,burst=MS,seed=S]  synthesizes N channels (default 2) of comma separated
+//                                             values, one line per frame, at HZ frames per second
+//                                             (default 1000). Values are sines plus noise from a
+//                                             seeded generator, so every run transmits the same bytes
+//   replay:FILE                               transmits the bytes of FILE (e.g. a raw dump of a serial
+//                                             stream, in any of the decoder formats), over and over
+// Bytes are released every MS milliseconds (default 1), in bursts of whatever the link would have
+// transmitted meanwhile: the baud rate limits the throughput to baudRate / 10 bytes per second, as
+// a real UART would. Synthesized frames that don't fit in the link back up, and when the backlog
+// exceeds a second worth of bytes the oldest ones are discarded (counted as overruns, shown in the
+// status bar and the headless statistics).
+class SimulatedPort : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    struct Settings
+    {
+        QString replayFile;
+        int channels;
+        double frameRate;
+        int burstInterval;
+        quint32 seed;
+    };
+
+    explicit SimulatedPort(const QString &portName, qint32 baudRate, QObject *parent = nullptr);
+    ~SimulatedPort();
+
+    // Returns true if portName selects a SimulatedPort rather than a serial port
+    static bool isSimulated(const QString &portName);
+
+    // Reads the settings from a port name. Returns false if it is not valid
+    static bool parse(const QString &portName, Settings &settings);
+
+    bool open(OpenMode mode) override;
+
+    void close() override;
+
+    bool isSequential() const override { return true; }
+
+    qint64 bytesAvailable() const override;
+
+    // Number of bytes discarded because the link couldn't keep up with the synthesized frames
+    quint64 overruns() const { return overrun; }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private slots:
+    void tick();
+
+private:
+    void synthesize(qint64 frames);
+
+    double noise();
+
+    QString portName;
+
+    qint32 baudRate;
+
+    Settings settings;
+
+    QTimer *timer;
+
+    QElapsedTimer clock;
+
+    QFile replay;
+
+    // Bytes generated but not transmitted yet (from backlogStart on), and bytes transmitted but
+    // not read yet (from pendingStart on)
+    QByteArray backlog;
+
+    int backlogStart;
+
+    QByteArray pending;
+
+    int pendingStart;
+
+    qint64 framesGenerated;
+
+    qint64 bytesTransmitted;
+
+    quint64 overrun;
+
+    quint32 state;
+};
+
+#endif // SIMULATEDPORT_H
@@ -0,0 +1,282 @@
+// Definition of methods for the StreamAligner class
+
+#include "streamaligner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+namespace {
+
+// Samples over which the period of a stream is first estimated
+const int warmupSamples = 16;
+
+// Gains of the alpha-beta filter. A small alpha averages the jitter over many samples
+// (about 1/alpha), and beta = alpha^2 / 4 makes the loop (nearly) critically damped
+const double alpha = 0.02;
+
+const double beta = alpha * alpha / 4;
+
+// A sample further than this from the model (in periods, and at least resyncTime seconds)
+// means a gap in the stream, or a device that restarted: the model restarts from it
+const double resyncPeriods = 16;
+
+const double resyncTime = 0.1;
+
+// Maximum number of rows computed by a call to align(), so a long gap is filled in several calls
+const qint64 maxRows = 65536;
+
+// Samples discarded from the front of a stream are only freed once there are this many of them
+const std::size_t compactThreshold = 4096;
+
+const double notANumber = std::numeric_limits<double>::quiet_NaN();
+
+}
+
+// Constructor of the StreamAligner class
+StreamAligner::StreamAligner()
+    : outputPeriod(1e-3)
+    , interpolation(Linear)
+    , lag(1.0)
+    , nextIndex(-1)
+{
+}
+
+void StreamAligner::reset(int count, double period, Interpolation interpolation)
+{
+    streams.assign(std::size_t(qMax(count, 0)), Stream());
+    outputPeriod = period;
+    this->interpolation = interpolation;
+    nextIndex = -1;
+}
+
+void StreamAligner::add(int index, double time, const double *values, int count)
+{
+    Stream &stream = streams[std::size_t(index)];
+    if (stream.channels == 0)
+    {
+        if (count <= 0)
+        {
+            return;
+        }
+        stream.channels = count;
+        stream.columns.resize(std::size_t(count));
+    }
+
+    // retimed samples never go backwards, so interpolation intervals are never negative
+    double retimed = retime(stream, time);
+    if (!stream.times.empty())
+    {
+        retimed = qMax(retimed, stream.times.back());
+    }
+    stream.times.push_back(retimed);
+    for (int c = 0; c < stream.channels; ++c)
+    {
+        stream.columns[std::size_t(c)].push_back(c < count ? values[c] : notANumber);
+    }
+    ++stream.received;
+}
+
+double StreamAligner::clockOffset(int index) const
+{
+    const Stream &stream = streams[std::size_t(index)];
+    return stream.phase - stream.period * double(stream.received - 1);
+}
+
+// Private method that updates the clock model of stream with a sample received at time,
+// and returns the time the model gives to that sample
+//
+// The period is first estimated over warmupSamples samples, whose times are kept as they are.
+// From then on, every sample is expected one period after the previous one: the difference
+// with its actual time (the residual) corrects the phase by a fraction alpha and the period
+// by a fraction beta, so the jitter averages out while drift is followed
+double StreamAligner::retime(Stream &stream, double time)
+{
+    if (stream.period <= 0)
+    {
+        if (stream.warmup == 0)
+        {
+            stream.warmupStart = time;
+        }
+        if (++stream.warmup >= warmupSamples)
+        {
+            stream.period = (time - stream.warmupStart) / (stream.warmup - 1);
+            stream.warmup = 0;
+        }
+        stream.phase = time;
+        return time;
+    }
+
+    const double predicted = stream.phase + stream.period;
+    const double residual = time - predicted;
+    if (std::abs(residual) > qMax(resyncPeriods * stream.period, resyncTime))
+    {
+        stream.phase = time;
+    } else
+    {
+        stream.phase = predicted + alpha * residual;
+        stream.period += beta * residual;
+    }
+    return stream.phase;
+}
+
+// Public method that resamples the streams at the output times reached by all of them
+//
+// The rows are computed column by column: a single pass over the samples of a stream finds the
+// interval every output time falls in, then every channel is interpolated in a tight loop over
+// those intervals (without searching, and without branches the compiler can't vectorize)
+int StreamAligner::align(ChannelBuffer &out)
+{
+    if (streams.empty() || outputPeriod <= 0)
+    {
+        return 0;
+    }
+
+    double latest = -std::numeric_limits<double>::infinity();
+    double start = latest;
+    int channels = 0;
+    for (const Stream &stream : streams)
+    {
+        if (stream.times.empty())
+        {
+            return 0;
+        }
+        latest = qMax(latest, stream.times.back());
+        start = qMax(start, stream.times.front());
+        channels += stream.channels;
+    }
+    if (nextIndex < 0)
+    {
+        nextIndex = qint64(std::ceil(start / outputPeriod));
+    }
+
+    // Output times must be followed by a sample (two with cubic interpolation) of every stream
+    // that is not lagging. If all of them start after the next output time (a gap), it jumps ahead
+    const std::size_t ahead = interpolation == Cubic ? 2 : 1;
+    double horizon = std::numeric_limits<double>::infinity();
+    double earliest = horizon;
+    for (const Stream &stream : streams)
+    {
+        if (stream.times.back() < latest - lag)
+        {
+            continue;
+        }
+        const std::size_t size = stream.times.size();
+        horizon = qMin(horizon, size - stream.first > ahead ? stream.times[size - ahead] : -std::numeric_limits<double>::infinity());
+        earliest = qMin(earliest, stream.times[stream.first]);
+    }
+    nextIndex = qMax(nextIndex, qint64(std::floor(earliest / outputPeriod)));
+    const qint64 rows = qMin(qint64(std::ceil(horizon / outputPeriod)) - nextIndex, maxRows);
+    if (rows <= 0)
+    {
+        return 0;
+    }
+
+    rowTimes.resize(std::size_t(rows));
+    sampleIndex.resize(std::size_t(rows));
+    fraction.resize(std::size_t(rows));
+    block.resize(std::size_t(channels));
+    row.resize(std::size_t(channels));
+    for (qint64 k = 0; k < rows; ++k)
+    {
+        rowTimes[std::size_t(k)] = double(nextIndex + k) * outputPeriod;
+    }
+
+    std::vector<double *> columns;
+    std::size_t column = 0;
+    for (Stream &stream : streams)
+    {
+        columns.clear();
+        for (int c = 0; c < stream.channels; ++c, ++column)
+        {
+            block[column].resize(std::size_t(rows));
+            columns.push_back(block[column].data());
+        }
+        if (stream.times.back() < latest - lag)
+        {
+            for (double *values : columns)
+            {
+                std::fill(values, values + rows, notANumber);
+            }
+            continue;
+        }
+        interpolate(stream, int(rows), columns.data());
+
+        // the samples before the interval of the last row (and the one before it, for cubic
+        // interpolation) are not needed anymore
+        stream.first = std::size_t(qMax(sampleIndex[std::size_t(rows - 1)] - 1, qint64(0)));
+        if (stream.first >= compactThreshold && stream.first > stream.times.size() / 2)
+        {
+            stream.times.erase(stream.times.begin(), stream.times.begin() + qint64(stream.first));
+            for (std::vector<double> &values : stream.columns)
+            {
+                values.erase(values.begin(), values.begin() + qint64(stream.first));
+            }
+            stream.first = 0;
+        }
+    }
+
+    for (qint64 k = 0; k < rows; ++k)
+    {
+        for (int c = 0; c < channels; ++c)
+        {
+            row[std::size_t(c)] = block[std::size_t(c)][std::size_t(k)];
+        }
+        out.append(rowTimes[std::size_t(k)], row.data(), channels);
+    }
+    nextIndex += rows;
+    return int(rows);
+}
+
+// Private method that interpolates every channel of stream at the first rows output times into out
+//
+// Output times before the first sample of the stream get NaN (through a NaN fraction)
+void StreamAligner::interpolate(const Stream &stream, int rows, double *const *out)
+{
+    const std::vector<double> &times = stream.times;
+    const qint64 last = qint64(times.size()) - 1;
+    qint64 j = qint64(stream.first);
+    for (int k = 0; k < rows; ++k)
+    {
+        const double t = rowTimes[std::size_t(k)];
+        while (j < last && times[std::size_t(j + 1)] <= t)
+        {
+            ++j;
+        }
+        const double dt = j < last ? times[std::size_t(j + 1)] - times[std::size_t(j)] : 0;
+        sampleIndex[std::size_t(k)] = j;
+        fraction[std::size_t(k)] = t < times[std::size_t(j)] ? notANumber : (dt > 0 ? (t - times[std::size_t(j)]) / dt : 0);
+    }
+
+    const qint64 *index = sampleIndex.data();
+    const double *u = fraction.data();
+    for (int c = 0; c < stream.channels; ++c)
+    {
+        const double *y = stream.columns[std::size_t(c)].data();
+        double *values = out[c];
+        if (interpolation == Linear)
+        {
+            for (int k = 0; k < rows; ++k)
+            {
+                const qint64 i = index[k];
+                const double y0 = y[i];
+                const double y1 = y[qMin(i + 1, last)];
+                values[k] = y0 + u[k] * (y1 - y0);
+            }
+        } else
+        {
+            // Catmull-Rom spline through the samples around the interval
+            for (int k = 0; k < rows; ++k)
+            {
+                const qint64 i = index[k];
+                const double p0 = y[qMax(i - 1, qint64(0))];
+                const double p1 = y[i];
+                const double p2 = y[qMin(i + 1, last)];
+                const double p3 = y[qMin(i + 2, last)];
+                const double t = u[k];
+                values[k] = p1 + 0.5 * t * (p2 - p0 + t * (2 * p0 - 5 * p1 + 4 * p2 - p3 + t * (3 * (p1 - p2) + p3 - p0)));
+            }
+        }
+    }
+}
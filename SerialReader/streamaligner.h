@@ -0,0 +1,111 @@
+#ifndef STREAMALIGNER_H
+#define STREAMALIGNER_H
+
+#include <QtGlobal>
+#include <vector>
+
+#include "channelbuffer.h"
+
+// Definition of the class that aligns the samples of several streams (one per serial port) on a common clock
+//
+// Every device samples with its own clock, and its samples reach the computer with jitter (USB frames,
+// scheduling). For every stream, the time of its n-th sample is modelled as offset + period * n and
+// tracked with an alpha-beta filter (a second order phase-locked loop): the offset is the phase of the
+// device relative to the clock samples are stamped with, and the period its actual sampling period,
+// which also tells the drift of its clock. Samples are retimed with the model, which removes the
+// arrival jitter, and every stream is resampled onto a common uniform timebase (multiples of the output
+// period) by linear or cubic (Catmull-Rom) interpolation. The output is a table with one row per output
+// time and the channels of all streams as columns, one stream after the other, that can be plotted and
+// exported as a single synchronized acquisition.
+//
+// Output starts once every stream has sent its first sample, and a row is produced as soon as every
+// stream has samples past its time. A stream lagging behind the others by more than maxLag() seconds
+// (e.g. a disconnected device) is output as NaN rather than holding back the rest.
+class StreamAligner
+{
+public:
+    enum Interpolation { Linear, Cubic };
+
+    StreamAligner();
+
+    // Discards all data and starts aligning streams streams onto a timebase of the given period (s)
+    void reset(int streams, double period, Interpolation interpolation);
+
+    int streamCount() const { return int(streams.size()); }
+
+    // Adds a sample of stream taken at time (s), which must not be earlier than the previous one.
+    // The channel count of a stream is that of its first sample: later ones are padded with NaN or cut to it
+    void add(int stream, double time, const double *values, int count);
+
+    // Appends to out the rows of all output times that can be computed so far. Returns their number
+    int align(ChannelBuffer &out);
+
+    // Number of channels of stream (0 until its first sample)
+    int channelCount(int stream) const { return streams[std::size_t(stream)].channels; }
+
+    // Clock model of stream, in seconds: estimated time of its first sample, and sampling period
+    // (0 while it is being estimated)
+    double clockOffset(int stream) const;
+
+    double clockPeriod(int stream) const { return streams[std::size_t(stream)].period; }
+
+    double maxLag() const { return lag; }
+
+    void setMaxLag(double seconds) { lag = seconds; }
+
+private:
+    struct Stream
+    {
+        Stream() : channels(0), first(0), received(0), warmup(0), warmupStart(0), phase(0), period(0) {}
+
+        int channels;
+
+        // Retimed samples, the first ones being discarded once no output time needs them anymore
+        std::vector<double> times;
+
+        std::vector<std::vector<double> > columns;
+
+        std::size_t first;
+
+        // Clock model: samples received, warm-up state, and time of the last sample and period
+        qint64 received;
+
+        int warmup;
+
+        double warmupStart;
+
+        double phase;
+
+        double period;
+    };
+
+    double retime(Stream &stream, double time);
+
+    void interpolate(const Stream &stream, int rows, double *const *out);
+
+    std::vector<Stream> streams;
+
+    double outputPeriod;
+
+    Interpolation interpolation;
+
+    double lag;
+
+    // Index (time / outputPeriod) of the next output time, -1 until every stream has started
+    qint64 nextIndex;
+
+    // Output times of the rows being computed, for every row the sample of a stream it is
+    // interpolated from and its position between that sample and the next one, the columns
+    // computed and a row of them (all reused by every call)
+    std::vector<double> rowTimes;
+
+    std::vector<qint64> sampleIndex;
+
+    std::vector<double> fraction;
+
+    std::vector<std::vector<double> > block;
+
+    std::vector<double> row;
+};
+
+#endif // STREAMALIGNER_H